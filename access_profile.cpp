@@ -0,0 +1,174 @@
+#include "access_profile.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "parse_stats.h"  // WriteJsonString
+
+namespace {
+
+struct GetterInfo {
+    const char* name;
+    VariableType type;  // type of the variables it reads
+};
+
+constexpr std::array<GetterInfo, AccessProfile::kGetterCount> kGetterInfo = {{
+        {"GetString", {ExpressionType::kString, false}},
+        {"GetInt", {ExpressionType::kInt, false}},
+        {"GetUint", {ExpressionType::kUint, false}},
+        {"GetFloat", {ExpressionType::kFloat, false}},
+        {"GetDouble", {ExpressionType::kDouble, false}},
+        {"GetBool", {ExpressionType::kBool, false}},
+        {"GetStringVector", {ExpressionType::kString, true}},
+        {"GetIntVector", {ExpressionType::kInt, true}},
+        {"GetUintVector", {ExpressionType::kUint, true}},
+        {"GetFloatVector", {ExpressionType::kFloat, true}},
+        {"GetDoubleVector", {ExpressionType::kDouble, true}},
+        {"GetBoolVector", {ExpressionType::kBool, true}},
+        {"GetStringView", {ExpressionType::kString, false}},
+        {"GetStringSpan", {ExpressionType::kString, true}},
+        {"GetIntSpan", {ExpressionType::kInt, true}},
+        {"GetUintSpan", {ExpressionType::kUint, true}},
+        {"GetFloatSpan", {ExpressionType::kFloat, true}},
+        {"GetDoubleSpan", {ExpressionType::kDouble, true}},
+        // Typed by each call instead
+        {"Lookup", {}},
+        {"Resolve", {}},
+        {"Get", {}},
+}};
+
+void Add(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->fetch_add(value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+/** AccessProfile **/
+
+void AccessProfile::Scope::Record() {
+    const uint64_t nanoseconds = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start)
+                    .count());
+    Shard& shard = _profile->ThreadShard();
+    GetterCounters& getter = shard.getters[static_cast<size_t>(_getter)];
+    Add(&getter.calls, 1);
+    Add(&getter.nanoseconds, nanoseconds);
+    const Variable* variable = _index.Find(_variable_name);
+    const VariableType type =
+            (_getter < Getter::kLookup) ? kGetterInfo[static_cast<size_t>(_getter)].type : _type;
+    if (variable == nullptr) {
+        Add(&getter.misses, 1);
+    } else if (variable->type != type) {
+        Add(&getter.wrong_types, 1);
+    } else {
+        KeyCounters& key = shard.keys[_index.Position(variable)];
+        Add(&key.reads, 1);
+        Add(&key.nanoseconds, nanoseconds);
+    }
+}
+
+void AccessProfile::HandleScope::Record() {
+    const uint64_t nanoseconds = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start)
+                    .count());
+    Shard& shard = _profile->ThreadShard();
+    GetterCounters& getter = shard.getters[static_cast<size_t>(Getter::kGet)];
+    Add(&getter.calls, 1);
+    Add(&getter.nanoseconds, nanoseconds);
+    const auto position = _profile->_key_positions.find(ValueKey(_type, _source, _slot));
+    if (position == _profile->_key_positions.end()) return;  // a handle of another config
+    KeyCounters& key = shard.keys[position->second];
+    Add(&key.reads, 1);
+    Add(&key.nanoseconds, nanoseconds);
+}
+
+AccessProfile::AccessProfile(const VariableIndex& index) : _key_count{index.Size()} {
+    for (Shard& shard : _shards) shard.keys = std::make_unique<KeyCounters[]>(_key_count);
+    _key_positions.reserve(_key_count);
+    uint32_t position = 0;
+    for (const auto& [name, variable] : index) {
+        _key_positions.emplace(ValueKey(variable.type, variable.source, variable.slot), position++);
+    }
+}
+
+uint64_t AccessProfile::ValueKey(VariableType type, uint16_t source, size_t slot) {
+    const uint64_t type_index = (static_cast<uint64_t>(type.type) << 1) | type.is_vector;
+    return (type_index << 48) | (uint64_t{source} << 32) | slot;
+}
+
+AccessProfile::Shard& AccessProfile::ThreadShard() {
+    // Threads are assigned shards round-robin on first use
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return _shards[shard % kShardCount];
+}
+
+AccessReport AccessProfile::Report(const VariableIndex& index, size_t hottest_key_count) const {
+    AccessReport report;
+    report.enabled = true;
+    std::vector<AccessReport::Key> keys;
+    size_t position = 0;
+    for (const auto& [name, variable] : index) {
+        AccessReport::Key key{std::string(name), 0, 0};
+        for (const Shard& shard : _shards) {
+            key.reads += shard.keys[position].reads.load(std::memory_order_relaxed);
+            key.nanoseconds += shard.keys[position].nanoseconds.load(std::memory_order_relaxed);
+        }
+        if (key.reads == 0) {
+            report.unread_keys.push_back(std::move(key.name));
+        } else {
+            keys.push_back(std::move(key));
+        }
+        ++position;
+    }
+    const size_t hottest_count = std::min(hottest_key_count, keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + hottest_count, keys.end(),
+                      [](const AccessReport::Key& a, const AccessReport::Key& b) {
+                          return a.reads > b.reads;
+                      });
+    keys.resize(hottest_count);
+    report.hottest_keys = std::move(keys);
+
+    for (size_t i = 0; i < kGetterCount; ++i) {
+        AccessReport::GetterCalls getter{kGetterInfo[i].name, 0, 0, 0, 0};
+        for (const Shard& shard : _shards) {
+            const GetterCounters& counters = shard.getters[i];
+            getter.calls += counters.calls.load(std::memory_order_relaxed);
+            getter.nanoseconds += counters.nanoseconds.load(std::memory_order_relaxed);
+            getter.misses += counters.misses.load(std::memory_order_relaxed);
+            getter.wrong_types += counters.wrong_types.load(std::memory_order_relaxed);
+        }
+        if (getter.calls != 0) report.getters.push_back(std::move(getter));
+    }
+    return report;
+}
+
+/** AccessReport **/
+
+std::string AccessReport::ToJson() const {
+    std::ostringstream json;
+    json << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"hottest_keys\": [";
+    for (size_t i = 0; i < hottest_keys.size(); ++i) {
+        json << ((i == 0) ? "" : ", ") << "{\"name\": ";
+        WriteJsonString(json, hottest_keys[i].name);
+        json << ", \"reads\": " << hottest_keys[i].reads
+             << ", \"nanoseconds\": " << hottest_keys[i].nanoseconds << "}";
+    }
+    json << "], \"getters\": [";
+    for (size_t i = 0; i < getters.size(); ++i) {
+        const GetterCalls& getter = getters[i];
+        json << ((i == 0) ? "" : ", ") << "{\"getter\": \"" << getter.getter
+             << "\", \"calls\": " << getter.calls << ", \"nanoseconds\": " << getter.nanoseconds
+             << ", \"misses\": " << getter.misses << ", \"wrong_types\": " << getter.wrong_types
+             << "}";
+    }
+    json << "], \"unread_keys\": [";
+    for (size_t i = 0; i < unread_keys.size(); ++i) {
+        if (i != 0) json << ", ";
+        WriteJsonString(json, unread_keys[i]);
+    }
+    json << "]}";
+    return json.str();
+}
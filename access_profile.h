@@ -0,0 +1,181 @@
+/* Opt-in profiling of getter calls, to find hot keys worth hoisting and keys that are never read.
+ *
+ * With ParseOptions::profile_access, every Get* call on a ConfigParser is timed and counted: per
+ * key (reads and time), and per getter (calls, time, misses and type mismatches). Lookup<T>,
+ * Resolve<T> and reads through a ValueHandle are counted the same way, each as a getter of its
+ * own, so that a key read only through them is not reported as unread. The report lists the
+ * hottest keys and the declared keys that were never read, e.g.:
+ *   ConfigParser config_parser("my_config.cfg", ParseOptions{.profile_access = true});
+ *   ...
+ *   std::cerr << config_parser.ReportAccesses(10).ToJson() << std::endl;
+ *
+ * Counters are relaxed atomics, sharded so that threads calling getters concurrently mostly update
+ * different cache lines: each thread uses one of kShardCount shards. Profiling costs a clock read
+ * and a second hash lookup per call, and 16 bytes per key per shard. Without it, a getter (or a
+ * handle read) only tests a null pointer.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "variable_index.h"
+
+// The Get* member functions of ConfigParser
+enum class Getter : uint8_t {
+    kGetString,
+    kGetInt,
+    kGetUint,
+    kGetFloat,
+    kGetDouble,
+    kGetBool,
+    kGetStringVector,
+    kGetIntVector,
+    kGetUintVector,
+    kGetFloatVector,
+    kGetDoubleVector,
+    kGetBoolVector,
+    kGetStringView,
+    kGetStringSpan,
+    kGetIntSpan,
+    kGetUintSpan,
+    kGetFloatSpan,
+    kGetDoubleSpan,
+    // Not getters, but profiled like them
+    kLookup,   // Lookup<T>
+    kResolve,  // Resolve<T>
+    kGet,      // Get(ValueHandle<T>)
+};
+
+// Result of ConfigParser::ReportAccesses
+struct AccessReport {
+    struct Key {
+        std::string name;
+        uint64_t reads;
+        uint64_t nanoseconds;  // total time spent in getters reading it
+    };
+
+    struct GetterCalls {
+        std::string getter;  // e.g. "GetDoubleVector"
+        uint64_t calls;
+        uint64_t nanoseconds;
+        uint64_t misses;       // no such variable
+        uint64_t wrong_types;  // variable of another type
+    };
+
+    bool enabled = false;  // whether the config was loaded with profile_access
+    std::vector<Key> hottest_keys;  // most read first
+    std::vector<GetterCalls> getters;  // getters called at least once, in Getter order
+    std::vector<std::string> unread_keys;  // in declaration order
+
+    // Machine-readable dump, as a single JSON object
+    std::string ToJson() const;
+};
+
+class AccessProfile {
+  public:
+    static constexpr size_t kShardCount = 8;
+    static constexpr size_t kGetterCount = static_cast<size_t>(Getter::kGet) + 1;
+
+    // Times one getter call, recording it when destroyed. Does nothing if profile is null.
+    class Scope {
+      public:
+        // A Get* getter, which reads variables of a single type
+        Scope(AccessProfile* profile,
+              Getter getter,
+              const VariableIndex& index,
+              std::string_view variable_name)
+            : Scope(profile, getter, VariableType{}, index, variable_name) {}
+        // Lookup or Resolve of a variable of the given type
+        Scope(AccessProfile* profile,
+              Getter getter,
+              VariableType type,
+              const VariableIndex& index,
+              std::string_view variable_name)
+            : _profile{profile},
+              _getter{getter},
+              _type{type},
+              _index{index},
+              _variable_name{variable_name} {
+            if (_profile != nullptr) [[unlikely]] _start = std::chrono::steady_clock::now();
+        }
+        ~Scope() {
+            if (_profile != nullptr) [[unlikely]] Record();
+        }
+
+      private:
+        void Record();
+
+        AccessProfile* _profile;
+        Getter _getter;
+        VariableType _type;
+        const VariableIndex& _index;
+        std::string_view _variable_name;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    // Times one read through a ValueHandle, recording it when destroyed. Does nothing if profile
+    // is null.
+    class HandleScope {
+      public:
+        HandleScope(AccessProfile* profile, VariableType type, uint16_t source, size_t slot)
+            : _profile{profile}, _type{type}, _source{source}, _slot{slot} {
+            if (_profile != nullptr) [[unlikely]] _start = std::chrono::steady_clock::now();
+        }
+        ~HandleScope() {
+            if (_profile != nullptr) [[unlikely]] Record();
+        }
+
+      private:
+        void Record();
+
+        AccessProfile* _profile;
+        VariableType _type;
+        uint16_t _source;
+        size_t _slot;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    // Profile for the variables of index, which must not change afterwards
+    explicit AccessProfile(const VariableIndex& index);
+
+    // Lists the hottest_key_count most read keys of index, the getters called, and unread keys
+    AccessReport Report(const VariableIndex& index, size_t hottest_key_count) const;
+
+  private:
+    struct KeyCounters {
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> nanoseconds{0};
+    };
+
+    struct GetterCounters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanoseconds{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> wrong_types{0};
+    };
+
+    struct alignas(64) Shard {
+        std::unique_ptr<KeyCounters[]> keys;  // indexed by position in the VariableIndex
+        std::array<GetterCounters, kGetterCount> getters;
+    };
+
+    // Shard used by the calling thread
+    Shard& ThreadShard();
+    // Key of a variable's value in _key_positions
+    static uint64_t ValueKey(VariableType type, uint16_t source, size_t slot);
+
+    size_t _key_count;
+    std::array<Shard, kShardCount> _shards;
+    // Positions in the VariableIndex by ValueKey, to count reads through handles
+    std::unordered_map<uint64_t, uint32_t> _key_positions;
+};
@@ -0,0 +1,348 @@
+#include "binary_cache.h"
+
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_WIN32)
+#include <random>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char kMagic[8] = "CPCACHE";
+constexpr uint32_t kFormatVersion = 2;
+
+// The format stores integers in native byte order, so caches are only used on little-endian hosts
+constexpr bool kCacheSupported = (std::endian::native == std::endian::little);
+
+/** Writing **/
+
+class CacheWriter {
+  public:
+    template <typename T>
+    void WriteRaw(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        _buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void WriteBytes(const char* data, size_t size) { _buffer.append(data, size); }
+
+    void WriteValue(int value) { WriteRaw<int32_t>(value); }
+    void WriteValue(size_t value) { WriteRaw<uint64_t>(value); }
+    void WriteValue(float value) { WriteRaw(value); }
+    void WriteValue(double value) { WriteRaw(value); }
+    void WriteValue(bool value) { WriteRaw<uint8_t>(value); }
+    void WriteValue(std::string_view value) {
+        WriteRaw<uint64_t>(value.size());
+        WriteBytes(value.data(), value.size());
+    }
+
+    template <typename T>
+    void WriteValue(const std::pmr::vector<T>& values) {
+        WriteRaw<uint64_t>(values.size());
+        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double> ||
+                      (std::is_same_v<T, size_t> && sizeof(size_t) == sizeof(uint64_t))) {
+            WriteBytes(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        } else {
+            for (const auto& value : values) WriteValue(static_cast<const T&>(value));
+        }
+    }
+
+    template <typename T>
+    void WriteSlot(const ValueStore& values, size_t slot) {
+        WriteValue(values.Slots<T>()[slot]);
+    }
+
+    const std::string& Buffer() const { return _buffer; }
+
+  private:
+    std::string _buffer;
+};
+
+template <typename Scalar>
+void WriteVariableValue(CacheWriter* writer, const Variable& variable, const ValueStore& values) {
+    if (variable.type.is_vector) {
+        writer->WriteSlot<std::vector<Scalar>>(values, variable.slot);
+    } else {
+        const Stored<Scalar>& value = values.Slots<Scalar>()[variable.slot];
+        writer->WriteValue(value);
+    }
+}
+
+/** Reading **/
+
+class CacheReader {
+  public:
+    explicit CacheReader(std::string_view contents) : _contents(contents), _offset{0} {}
+
+    template <typename T>
+    bool ReadRaw(T* value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (_contents.size() - _offset < sizeof(T)) return false;
+        std::memcpy(value, _contents.data() + _offset, sizeof(T));
+        _offset += sizeof(T);
+        return true;
+    }
+
+    bool ReadBytes(size_t size, std::string_view* bytes) {
+        if (_contents.size() - _offset < size) return false;
+        *bytes = _contents.substr(_offset, size);
+        _offset += size;
+        return true;
+    }
+
+    bool ReadValue(int* value) { return ReadConverted<int32_t>(value); }
+    bool ReadValue(size_t* value) { return ReadConverted<uint64_t>(value); }
+    bool ReadValue(float* value) { return ReadRaw(value); }
+    bool ReadValue(double* value) { return ReadRaw(value); }
+    bool ReadValue(bool* value) {
+        uint8_t byte = 0;
+        if (!ReadRaw(&byte) || (byte > 1)) return false;
+        *value = (byte != 0);
+        return true;
+    }
+    bool ReadValue(std::pmr::string* value) {
+        uint64_t size = 0;
+        std::string_view bytes;
+        if (!ReadRaw(&size) || !ReadBytes(size, &bytes)) return false;
+        value->assign(bytes);
+        return true;
+    }
+
+    template <typename T>
+    bool ReadValue(std::pmr::vector<T>* values) {
+        uint64_t count = 0;
+        // Every element takes at least one byte, which bounds the count of a valid vector
+        if (!ReadRaw(&count) || (count > _contents.size() - _offset)) return false;
+        if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double> ||
+                      (std::is_same_v<T, size_t> && sizeof(size_t) == sizeof(uint64_t))) {
+            std::string_view bytes;
+            if ((count > SIZE_MAX / sizeof(T)) || !ReadBytes(count * sizeof(T), &bytes)) {
+                return false;
+            }
+            values->resize(count);
+            if (count != 0) std::memcpy(values->data(), bytes.data(), bytes.size());
+        } else {
+            values->resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                if constexpr (std::is_same_v<T, bool>) {  // bit-packed
+                    bool value = false;
+                    if (!ReadValue(&value)) return false;
+                    (*values)[i] = value;
+                } else if (!ReadValue(&(*values)[i])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool AtEnd() const { return _offset == _contents.size(); }
+    std::string_view Remaining() const { return _contents.substr(_offset); }
+
+  private:
+    template <typename Stored, typename T>
+    bool ReadConverted(T* value) {
+        Stored stored{};
+        if (!ReadRaw(&stored)) return false;
+        *value = static_cast<T>(stored);
+        return true;
+    }
+
+    std::string_view _contents;
+    size_t _offset;
+};
+
+template <typename Scalar>
+bool ReadVariableValue(CacheReader* reader, bool is_vector, ValueStore* values, size_t* slot) {
+    // Read in place in the store's memory, so that storing moves rather than copies
+    if (is_vector) {
+        Stored<std::vector<Scalar>> value(values->Resource());
+        if (!reader->ReadValue(&value)) return false;
+        *slot = values->Add<std::vector<Scalar>>(std::move(value));
+    } else if constexpr (std::is_same_v<Scalar, std::string>) {
+        std::pmr::string value(values->Resource());
+        if (!reader->ReadValue(&value)) return false;
+        *slot = values->Add<Scalar>(std::move(value));
+    } else {
+        Scalar value{};
+        if (!reader->ReadValue(&value)) return false;
+        *slot = values->Add<Scalar>(value);
+    }
+    return true;
+}
+
+// Mixes a 64-bit value so that every input bit affects every output bit
+uint64_t Mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/** File output **/
+
+// Writes header then payload to a new file with a unique name next to path, and renames it to
+// path, so that concurrent writers of the same cache never rename each other's partial files
+bool WriteFileAtomically(const std::string& path,
+                         const std::string& header,
+                         const std::string& payload) {
+#if defined(_WIN32)
+    std::string temporary_path;
+    std::FILE* file = nullptr;
+    std::random_device random_device;
+    for (int attempt = 0; (file == nullptr) && (attempt < 16); ++attempt) {
+        temporary_path = path + ".tmp." + std::to_string(random_device());
+        file = std::fopen(temporary_path.c_str(), "wbx");  // fails if the file exists
+    }
+    if (file == nullptr) return false;
+    bool written = (std::fwrite(header.data(), 1, header.size(), file) == header.size()) &&
+                   (std::fwrite(payload.data(), 1, payload.size(), file) == payload.size());
+    written = (std::fclose(file) == 0) && written;
+#else
+    std::string temporary_path = path + ".XXXXXX";
+    const int fd = ::mkstemp(temporary_path.data());
+    if (fd < 0) return false;
+    const auto write_all = [fd](const std::string& bytes) {
+        for (size_t offset = 0; offset < bytes.size();) {
+            const ssize_t written = ::write(fd, bytes.data() + offset, bytes.size() - offset);
+            if (written < 0) return false;
+            offset += static_cast<size_t>(written);
+        }
+        return true;
+    };
+    // mkstemp creates the file readable by its owner only; caches are as readable as configs
+    bool written = (::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0) &&
+                   write_all(header) && write_all(payload);
+    written = (::close(fd) == 0) && written;
+#endif
+    if (written && (std::rename(temporary_path.c_str(), path.c_str()) == 0)) return true;
+    std::remove(temporary_path.c_str());
+    return false;
+}
+
+}  // namespace
+
+uint64_t HashContents(std::string_view contents) {
+    uint64_t hash = Mix64(contents.size() ^ 0x9e3779b97f4a7c15ULL);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= contents.size(); i += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, contents.data() + i, sizeof(word));
+        hash = std::rotl(hash ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+    }
+    uint64_t tail = 0;
+    if (i < contents.size()) std::memcpy(&tail, contents.data() + i, contents.size() - i);
+    return Mix64(hash ^ tail);
+}
+
+bool WriteBinaryCache(const std::string& cache_path,
+                      std::string_view source_contents,
+                      const VariableIndex& var_map,
+                      const ValueStore& values) {
+    if (!kCacheSupported) return false;
+    CacheWriter writer;  // payload, written after the header
+    writer.WriteRaw<uint64_t>(var_map.Size());
+    // Variables are written in declaration order, so that loading appends each value to the same
+    // slot it had when parsed (keeping ValueHandles valid across cached and parsed loads)
+    for (const auto& [name, variable] : var_map) {
+        const ExpressionType type = variable.type.type;
+        writer.WriteRaw<uint32_t>(static_cast<uint32_t>(name.size()));
+        writer.WriteBytes(name.data(), name.size());
+        writer.WriteRaw<uint8_t>(static_cast<uint8_t>(type));
+        writer.WriteRaw<uint8_t>(variable.type.is_vector);
+        switch (type) {
+            case ExpressionType::kString:
+                WriteVariableValue<std::string>(&writer, variable, values);
+                break;
+            case ExpressionType::kInt:
+                WriteVariableValue<int>(&writer, variable, values);
+                break;
+            case ExpressionType::kUint:
+                WriteVariableValue<size_t>(&writer, variable, values);
+                break;
+            case ExpressionType::kFloat:
+                WriteVariableValue<float>(&writer, variable, values);
+                break;
+            case ExpressionType::kDouble:
+                WriteVariableValue<double>(&writer, variable, values);
+                break;
+            case ExpressionType::kBool:
+                WriteVariableValue<bool>(&writer, variable, values);
+                break;
+        }
+    }
+    CacheWriter header_writer;
+    header_writer.WriteBytes(kMagic, sizeof(kMagic));
+    header_writer.WriteRaw<uint32_t>(kFormatVersion);
+    header_writer.WriteRaw<uint64_t>(source_contents.size());
+    header_writer.WriteRaw<uint64_t>(HashContents(source_contents));
+    header_writer.WriteRaw<uint64_t>(HashContents(writer.Buffer()));
+    return WriteFileAtomically(cache_path, header_writer.Buffer(), writer.Buffer());
+}
+
+bool ReadBinaryCache(std::string_view cache_contents,
+                     std::string_view source_contents,
+                     VariableIndex* var_map,
+                     ValueStore* values) {
+    if (!kCacheSupported) return false;
+    CacheReader reader(cache_contents);
+    std::string_view magic;
+    uint32_t version = 0;
+    uint64_t source_size = 0, source_hash = 0, payload_hash = 0, variable_count = 0;
+    if (!reader.ReadBytes(sizeof(kMagic), &magic) ||
+        (magic != std::string_view(kMagic, sizeof(kMagic))) || !reader.ReadRaw(&version) ||
+        (version != kFormatVersion) || !reader.ReadRaw(&source_size) ||
+        (source_size != source_contents.size()) || !reader.ReadRaw(&source_hash) ||
+        (source_hash != HashContents(source_contents)) || !reader.ReadRaw(&payload_hash) ||
+        (payload_hash != HashContents(reader.Remaining())) || !reader.ReadRaw(&variable_count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < variable_count; ++i) {
+        uint32_t name_size = 0;
+        std::string_view name;
+        uint8_t type_byte = 0, is_vector_byte = 0;
+        if (!reader.ReadRaw(&name_size) || !reader.ReadBytes(name_size, &name) ||
+            !reader.ReadRaw(&type_byte) || !reader.ReadRaw(&is_vector_byte) ||
+            (type_byte >= ConfigParser::kValidTypeStrings.size()) || (is_vector_byte > 1)) {
+            return false;
+        }
+        const ExpressionType type = static_cast<ExpressionType>(type_byte);
+        const bool is_vector = (is_vector_byte != 0);
+        size_t slot = 0;
+        bool read_ok = false;
+        switch (type) {
+            case ExpressionType::kString:
+                read_ok = ReadVariableValue<std::string>(&reader, is_vector, values, &slot);
+                break;
+            case ExpressionType::kInt:
+                read_ok = ReadVariableValue<int>(&reader, is_vector, values, &slot);
+                break;
+            case ExpressionType::kUint:
+                read_ok = ReadVariableValue<size_t>(&reader, is_vector, values, &slot);
+                break;
+            case ExpressionType::kFloat:
+                read_ok = ReadVariableValue<float>(&reader, is_vector, values, &slot);
+                break;
+            case ExpressionType::kDouble:
+                read_ok = ReadVariableValue<double>(&reader, is_vector, values, &slot);
+                break;
+            case ExpressionType::kBool:
+                read_ok = ReadVariableValue<bool>(&reader, is_vector, values, &slot);
+                break;
+        }
+        if (!read_ok) return false;
+        if (!var_map->Insert(name, Variable{VariableType{type, is_vector}, 0,
+                                            static_cast<uint32_t>(slot)})) {
+            return false;  // duplicate name
+        }
+    }
+    return reader.AtEnd();
+}
@@ -0,0 +1,43 @@
+/* Binary cache of parsed configs.
+ *
+ * A cache file stores every variable of a successfully parsed config (name, type and typed value,
+ * with numeric vectors as raw little-endian arrays), keyed by the size and content hash of the
+ * source file it was parsed from. Loading the cache only copies values out of the mapped file,
+ * skipping tokenizing and number conversion entirely.
+ *
+ * Layout (all integers little-endian):
+ *   header:   magic "CPCACHE", format version (u32), source size (u64), source hash (u64),
+ *             payload hash (u64), the hash of everything after the header
+ *   payload:  variable count (u64), variables
+ *   variable: name length (u32), name bytes, type (u8, ExpressionType), is_vector (u8), value
+ *   value:    int as i32, uint as u64, float as f32, double as f64, bool as u8,
+ *             string as length (u64) + bytes; vectors as element count (u64) + elements
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "config_parser.h"
+
+// Content hash of a source file, used as the cache key
+uint64_t HashContents(std::string_view contents);
+
+// Writes the variables and values of a parsed config to cache_path. The file is written under a
+// unique temporary name and then renamed, so readers never see a partial cache, even with several
+// processes writing it at once. Returns false on failure.
+bool WriteBinaryCache(const std::string& cache_path,
+                      std::string_view source_contents,
+                      const VariableIndex& var_map,
+                      const ValueStore& values);
+
+// Loads variables and values from cache_contents if it is a valid cache for source_contents.
+// Returns false if the cache is stale, corrupted (its payload hash does not match), malformed, or
+// from another format version, in which case var_map and values may be partially filled and
+// should be discarded.
+bool ReadBinaryCache(std::string_view cache_contents,
+                     std::string_view source_contents,
+                     VariableIndex* var_map,
+                     ValueStore* values);
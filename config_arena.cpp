@@ -0,0 +1,36 @@
+#include "config_arena.h"
+
+ConfigArena::ConfigArena(std::pmr::memory_resource* upstream)
+    : ConfigArena(upstream, nullptr) {}
+
+ConfigArena::ConfigArena(std::pmr::memory_resource* upstream, const ConfigArena* family)
+    : _upstream{(upstream != nullptr) ? upstream : std::pmr::new_delete_resource()},
+      _family{(family != nullptr) ? family : this},
+      _buffer(_upstream) {}
+
+std::unique_ptr<ConfigArena> ConfigArena::NewSibling() const {
+    return std::unique_ptr<ConfigArena>(new ConfigArena(_upstream, _family));
+}
+
+void ConfigArena::Adopt(std::unique_ptr<ConfigArena> sibling) {
+    const std::lock_guard<std::mutex> lock(_mutex);
+    _adopted.push_back(std::move(sibling));
+}
+
+void* ConfigArena::do_allocate(size_t bytes, size_t alignment) {
+    const std::lock_guard<std::mutex> lock(_mutex);
+    if (bytes >= kDirectAllocationSize) return _upstream->allocate(bytes, alignment);
+    return _buffer.allocate(bytes, alignment);
+}
+
+void ConfigArena::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    // Siblings share the upstream resource, so this may free their direct allocations too
+    if (bytes < kDirectAllocationSize) return;  // released with the arena
+    const std::lock_guard<std::mutex> lock(_mutex);
+    _upstream->deallocate(pointer, bytes, alignment);
+}
+
+bool ConfigArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    const ConfigArena* other_arena = dynamic_cast<const ConfigArena*>(&other);
+    return (other_arena != nullptr) && (other_arena->_family == _family);
+}
@@ -0,0 +1,57 @@
+/* Arena memory for the values and variable index of a ConfigParser.
+ *
+ * A ConfigParser allocates its parsed strings and vectors, the arrays holding them, and the
+ * buffers of its variable index from its own ConfigArena: a monotonic buffer that hands out memory
+ * by bumping a pointer, taking blocks of growing size from an upstream std::pmr::memory_resource
+ * (ParseOptions::memory_resource, or the global heap by default). A load thus makes a handful of
+ * upstream allocations instead of one or more per value, and destroying the ConfigParser returns
+ * those blocks at once.
+ *
+ * Memory given back to a monotonic buffer is not reused, so the arrays that grow while a config is
+ * parsed would leave their old buffers behind. Allocations of at least kDirectAllocationSize bytes
+ * (large arrays and vectors) therefore go straight to the upstream resource and are returned to it
+ * when freed, which bounds that waste at a few times kDirectAllocationSize per array while keeping
+ * the number of upstream allocations logarithmic in the size of the config.
+ *
+ * The arenas that the ranges of a parallel parse are parsed into are siblings of the arena of the
+ * parser they are merged into, which adopts them: siblings compare equal, so that merging moves
+ * values rather than copying them, and adopted arenas live as long as their adopter.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+class ConfigArena final : public std::pmr::memory_resource {
+  public:
+    static constexpr size_t kDirectAllocationSize = size_t{64} << 10;
+
+    // Uses std::pmr::new_delete_resource() if upstream is null
+    explicit ConfigArena(std::pmr::memory_resource* upstream = nullptr);
+
+    // New arena with the same upstream, equal to this one, for parsing part of its config
+    std::unique_ptr<ConfigArena> NewSibling() const;
+    // Keeps sibling, and everything allocated from it, alive until this arena is destroyed
+    void Adopt(std::unique_ptr<ConfigArena> sibling);
+
+    std::pmr::memory_resource* Upstream() const { return _upstream; }
+
+  private:
+    ConfigArena(std::pmr::memory_resource* upstream, const ConfigArena* family);
+
+    // Allocation takes a lock, since lazily parsed values are stored by whichever thread first
+    // reads them
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    std::pmr::memory_resource* _upstream;
+    const ConfigArena* _family;  // the first arena of a group of siblings
+    std::mutex _mutex;
+    std::pmr::monotonic_buffer_resource _buffer;
+    std::vector<std::unique_ptr<ConfigArena>> _adopted;
+};
@@ -0,0 +1,419 @@
+/* Benchmarks for parsing and lookups on synthetic configs.
+ *
+ * Generates configs with many scalars, with long string vectors using the same tricky quoting as
+ * the words entry of test_config.cfg, and with multi-million-element float[] and int[] arrays.
+ * Reports parse throughput (MB/s and declarations/s), peak resident set size while parsing, and
+ * the latency of each getter. Results are written as JSON (to stdout, or to the file given with
+ * --output) with names that are stable across commits, so that runs can be compared; a summary is
+ * printed to stderr. Usage:
+ *   config_bench [--scale S] [--repetitions R] [--output results.json]
+ * where S (default 1) multiplies every config size, e.g. 0.01 for a quick smoke run.
+ */
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "config_parser.h"
+
+namespace {
+
+struct BenchOptions {
+    double scale = 1.0;
+    size_t repetitions = 5;
+    std::string output_path;  // stdout if empty
+};
+
+struct SyntheticConfig {
+    std::string name;
+    std::string contents;
+    size_t declarations;
+};
+
+struct ParseResult {
+    std::string name;
+    size_t bytes;
+    size_t declarations;
+    double seconds;  // median over repetitions
+    // Peak resident set size while parsing, less the resident set size before parsing (which
+    // includes memory the allocator kept from generating the configs)
+    long peak_rss_growth_kb;
+};
+
+struct GetterResult {
+    std::string name;
+    size_t calls;
+    double nanoseconds_per_call;
+};
+
+/** Synthetic configs **/
+
+// Same tricky elements as the words entry of test_config.cfg, plus terminators and comment
+// characters inside strings
+const std::vector<std::string> kTrickyStrings = {
+        "\"]\"", "\"[\"", "\", \"", "\"[1, 2, 3]\"", "\"a;b\"", "\"# not a comment\"", "\"\""};
+
+size_t Scaled(size_t count, double scale) {
+    return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(count) * scale));
+}
+
+std::string GenerateScalars(size_t count, std::mt19937* random) {
+    std::uniform_int_distribution<int> int_distribution(-1000000, 1000000);
+    std::uniform_real_distribution<double> real_distribution(-1e6, 1e6);
+    std::ostringstream config;
+    config << "# Scalars of every type\n";
+    for (size_t i = 0; i < count; ++i) {
+        switch (i % 6) {
+            case 0:
+                config << "int int_" << i << " = " << int_distribution(*random) << ";\n";
+                break;
+            case 1:
+                config << "uint uint_" << i << " = " << (i * 7919) << ";\n";
+                break;
+            case 2:
+                config << "float float_" << i << " = " << real_distribution(*random) << ";\n";
+                break;
+            case 3:
+                config << "double double_" << i << " = " << real_distribution(*random)
+                       << ";  # trailing comment\n";
+                break;
+            case 4:
+                config << "bool bool_" << i << " = " << ((i % 4 == 0) ? "true" : "false")
+                       << ";\n";
+                break;
+            default:
+                config << "string string_" << i << " = \"value " << i << " with ; and #\";\n";
+                break;
+        }
+    }
+    return config.str();
+}
+
+std::string GenerateStringVectors(size_t count, size_t length) {
+    std::ostringstream config;
+    for (size_t i = 0; i < count; ++i) {
+        config << "# Vector " << i << " with \"quotes\" and ; in a comment\n";
+        config << "string[] words_" << i << " =\n    [";
+        for (size_t j = 0; j < length; ++j) {
+            if (j != 0) config << ((j % 8 == 0) ? ",\n     " : ", ");
+            if (j % 3 == 0) {
+                config << kTrickyStrings[(i + j) % kTrickyStrings.size()];
+            } else {
+                config << "\"word_" << j << "\"";
+            }
+        }
+        config << "];\n";
+    }
+    return config.str();
+}
+
+std::string GenerateFloatArray(size_t length, std::mt19937* random) {
+    std::uniform_real_distribution<float> distribution(-1000.0f, 1000.0f);
+    std::string config = "float[] floats = [";
+    char number[32];
+    for (size_t i = 0; i < length; ++i) {
+        if (i != 0) config += (i % 16 == 0) ? ",\n    " : ", ";
+        std::snprintf(number, sizeof(number), "%.6g", distribution(*random));
+        config += number;
+    }
+    config += "];\n";
+    return config;
+}
+
+std::string GenerateIntArray(size_t length, std::mt19937* random) {
+    std::uniform_int_distribution<int> distribution;
+    std::string config = "int[] ints = [";
+    for (size_t i = 0; i < length; ++i) {
+        if (i != 0) config += (i % 16 == 0) ? ",\n    " : ", ";
+        config += std::to_string((i % 2 == 0) ? distribution(*random) : -distribution(*random));
+    }
+    config += "];\n";
+    return config;
+}
+
+// count variables of each getter type, named <type>_<index>, with 6 elements per vector
+std::string GenerateGetterConfig(size_t count) {
+    std::ostringstream config;
+    for (size_t i = 0; i < count; ++i) {
+        config << "string s_" << i << " = \"value " << i << "\";\n";
+        config << "int i_" << i << " = " << i << ";\n";
+        config << "uint u_" << i << " = " << i << ";\n";
+        config << "float f_" << i << " = " << i << ".5;\n";
+        config << "double d_" << i << " = " << i << ".25;\n";
+        config << "bool b_" << i << " = " << ((i % 2 == 0) ? "true" : "false") << ";\n";
+        config << "string[] sv_" << i << " = [\"a\", \"b\", \"c\", \"d\", \"e\", \"f\"];\n";
+        config << "int[] iv_" << i << " = [1, 2, 3, 4, 5, 6];\n";
+        config << "uint[] uv_" << i << " = [1, 2, 3, 4, 5, 6];\n";
+        config << "float[] fv_" << i << " = [1, 2, 3, 4, 5, 6];\n";
+        config << "double[] dv_" << i << " = [1, 2, 3, 4, 5, 6];\n";
+        config << "bool[] bv_" << i << " = [true, false, true, false, true, false];\n";
+    }
+    return config.str();
+}
+
+/** Measurement **/
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Resets the peak resident set size reported by PeakRssKb, where the kernel supports it (Linux)
+void ResetPeakRss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs) clear_refs << "5";
+}
+
+// Value in kB of a field of /proc/self/status, or -1 if it is not available
+long ProcessStatusKb(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind(field, 0) == 0) return std::stol(line.substr(field.size()));
+    }
+    return -1;
+}
+
+// Peak resident set size in kB since the last ResetPeakRss, or over the whole process where it
+// cannot be reset
+long PeakRssKb() {
+    const long peak_rss_kb = ProcessStatusKb("VmHWM:");
+    if (peak_rss_kb >= 0) return peak_rss_kb;
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Current resident set size in kB, or 0 if it is not available
+long RssKb() {
+    return std::max(0L, ProcessStatusKb("VmRSS:"));
+}
+
+ParseResult BenchmarkParse(const SyntheticConfig& config,
+                           const std::filesystem::path& config_path,
+                           const BenchOptions& options) {
+    ParseResult result{config.name, std::filesystem::file_size(config_path), config.declarations,
+                       0.0, 0};
+    std::vector<double> seconds;
+    for (size_t repetition = 0; repetition < options.repetitions; ++repetition) {
+        ResetPeakRss();
+        const long start_rss_kb = RssKb();
+        const auto start = std::chrono::steady_clock::now();
+        const ConfigParser config_parser(config_path.string());
+        seconds.push_back(Seconds(start));
+        result.peak_rss_growth_kb =
+                std::max(result.peak_rss_growth_kb, PeakRssKb() - start_rss_kb);
+        if (config_parser.ErrorCount() != 0) {
+            std::cerr << config_parser.ErrorString() << std::endl;
+            std::exit(1);
+        }
+    }
+    std::sort(seconds.begin(), seconds.end());
+    result.seconds = seconds[seconds.size() / 2];
+    return result;
+}
+
+// Calls get(name) for each name in turn until about call_count calls have been made
+template <typename Getter>
+GetterResult BenchmarkGetter(const std::string& name,
+                             const std::vector<std::string>& variable_names,
+                             size_t call_count,
+                             Getter get) {
+    const size_t rounds = std::max<size_t>(1, call_count / variable_names.size());
+    size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (const std::string& variable_name : variable_names) checksum += get(variable_name);
+    }
+    const double seconds = Seconds(start);
+    const size_t calls = rounds * variable_names.size();
+    // Keeps the calls from being optimized away
+    if (checksum == static_cast<size_t>(-1)) std::cerr << checksum << std::endl;
+    return GetterResult{name, calls, seconds * 1e9 / static_cast<double>(calls)};
+}
+
+std::vector<std::string> VariableNames(const std::string& prefix, size_t count) {
+    std::vector<std::string> variable_names;
+    for (size_t i = 0; i < count; ++i) variable_names.push_back(prefix + std::to_string(i));
+    return variable_names;
+}
+
+std::vector<GetterResult> BenchmarkGetters(const ConfigParser& parser,
+                                           size_t variable_count,
+                                           size_t call_count) {
+    const auto names = [&](const std::string& prefix) {
+        return VariableNames(prefix, variable_count);
+    };
+    const ConfigParser& p = parser;  // keeps the calls below on one line
+    std::vector<GetterResult> results;
+    // Each getter's result is reduced to a number so that it cannot be discarded
+    results.push_back(BenchmarkGetter("GetString", names("s_"), call_count, [&](auto& name) {
+        return p.GetString(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetInt", names("i_"), call_count, [&](auto& name) {
+        return static_cast<size_t>(p.GetInt(name));
+    }));
+    results.push_back(BenchmarkGetter("GetUint", names("u_"), call_count, [&](auto& name) {
+        return p.GetUint(name);
+    }));
+    results.push_back(BenchmarkGetter("GetFloat", names("f_"), call_count, [&](auto& name) {
+        return static_cast<size_t>(p.GetFloat(name));
+    }));
+    results.push_back(BenchmarkGetter("GetDouble", names("d_"), call_count, [&](auto& name) {
+        return static_cast<size_t>(p.GetDouble(name));
+    }));
+    results.push_back(BenchmarkGetter("GetBool", names("b_"), call_count, [&](auto& name) {
+        return static_cast<size_t>(p.GetBool(name));
+    }));
+    results.push_back(BenchmarkGetter("GetStringVector", names("sv_"), call_count, [&](auto& name) {
+        return p.GetStringVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetIntVector", names("iv_"), call_count, [&](auto& name) {
+        return p.GetIntVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetUintVector", names("uv_"), call_count, [&](auto& name) {
+        return p.GetUintVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetFloatVector", names("fv_"), call_count, [&](auto& name) {
+        return p.GetFloatVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetDoubleVector", names("dv_"), call_count, [&](auto& name) {
+        return p.GetDoubleVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetBoolVector", names("bv_"), call_count, [&](auto& name) {
+        return p.GetBoolVector(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetStringView", names("s_"), call_count, [&](auto& name) {
+        return p.GetStringView(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetStringSpan", names("sv_"), call_count, [&](auto& name) {
+        return p.GetStringSpan(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetIntSpan", names("iv_"), call_count, [&](auto& name) {
+        return p.GetIntSpan(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetUintSpan", names("uv_"), call_count, [&](auto& name) {
+        return p.GetUintSpan(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetFloatSpan", names("fv_"), call_count, [&](auto& name) {
+        return p.GetFloatSpan(name).size();
+    }));
+    results.push_back(BenchmarkGetter("GetDoubleSpan", names("dv_"), call_count, [&](auto& name) {
+        return p.GetDoubleSpan(name).size();
+    }));
+    return results;
+}
+
+/** Output **/
+
+void WriteJson(const BenchOptions& options,
+               const std::vector<ParseResult>& parse_results,
+               const std::vector<GetterResult>& getter_results,
+               std::ostream& output) {
+    output << "{\n  \"scale\": " << options.scale << ",\n  \"repetitions\": "
+           << options.repetitions << ",\n  \"parse\": [";
+    for (size_t i = 0; i < parse_results.size(); ++i) {
+        const ParseResult& result = parse_results[i];
+        output << ((i == 0) ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+               << "\", \"bytes\": " << result.bytes << ", \"declarations\": "
+               << result.declarations << ", \"seconds\": " << result.seconds
+               << ", \"mb_per_second\": " << (result.bytes / 1e6 / result.seconds)
+               << ", \"declarations_per_second\": " << (result.declarations / result.seconds)
+               << ", \"peak_rss_growth_kb\": " << result.peak_rss_growth_kb << "}";
+    }
+    output << "\n  ],\n  \"getters\": [";
+    for (size_t i = 0; i < getter_results.size(); ++i) {
+        const GetterResult& result = getter_results[i];
+        output << ((i == 0) ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+               << "\", \"calls\": " << result.calls
+               << ", \"nanoseconds_per_call\": " << result.nanoseconds_per_call << "}";
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    output << "\n  ],\n  \"process_peak_rss_kb\": " << usage.ru_maxrss << "\n}\n";
+}
+
+bool ParseArguments(int argc, char** argv, BenchOptions* options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string argument = argv[i];
+        if (argument == "--scale") {
+            options->scale = std::stod(argv[i + 1]);
+        } else if (argument == "--repetitions") {
+            options->repetitions = std::max(1, std::stoi(argv[i + 1]));
+        } else if (argument == "--output") {
+            options->output_path = argv[i + 1];
+        } else {
+            return false;
+        }
+    }
+    return (argc % 2 == 1) && (options->scale > 0.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseArguments(argc, argv, &options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--scale S] [--repetitions R] [--output results.json]" << std::endl;
+        return 1;
+    }
+
+    // Write the synthetic configs
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() /
+                                            ("config_bench_" + std::to_string(getpid()));
+    std::filesystem::create_directories(directory);
+    std::mt19937 random(12345);
+    const size_t scalar_count = Scaled(200000, options.scale);
+    const size_t string_vector_count = Scaled(2000, options.scale);
+    const size_t array_length = Scaled(4000000, options.scale);
+    std::vector<SyntheticConfig> configs = {
+            {"scalars", GenerateScalars(scalar_count, &random), scalar_count},
+            {"string_vectors",
+             GenerateStringVectors(string_vector_count, Scaled(500, options.scale)),
+             string_vector_count},
+            {"float_array", GenerateFloatArray(array_length, &random), 1},
+            {"int_array", GenerateIntArray(array_length, &random), 1},
+    };
+    for (SyntheticConfig& config : configs) {
+        std::ofstream(directory / (config.name + ".cfg"), std::ios::binary) << config.contents;
+        config.contents = std::string();  // not counted in the peak RSS of parsing
+    }
+
+    std::vector<ParseResult> parse_results;
+    for (const SyntheticConfig& config : configs) {
+        parse_results.push_back(
+                BenchmarkParse(config, directory / (config.name + ".cfg"), options));
+        const ParseResult& result = parse_results.back();
+        std::cerr << result.name << ": " << result.bytes / 1e6 / result.seconds << " MB/s, "
+                  << result.declarations / result.seconds << " declarations/s, peak RSS +"
+                  << result.peak_rss_growth_kb << " kB" << std::endl;
+    }
+
+    const size_t variable_count = 1024;
+    const ConfigParser getter_parser =
+            ConfigParser::FromBuffer(GenerateGetterConfig(variable_count));
+    const std::vector<GetterResult> getter_results =
+            BenchmarkGetters(getter_parser, variable_count, Scaled(1000000, options.scale));
+    for (const GetterResult& result : getter_results) {
+        std::cerr << result.name << ": " << result.nanoseconds_per_call << " ns" << std::endl;
+    }
+
+    std::filesystem::remove_all(directory);
+    if (options.output_path.empty()) {
+        WriteJson(options, parse_results, getter_results, std::cout);
+    } else {
+        std::ofstream output(options.output_path);
+        WriteJson(options, parse_results, getter_results, output);
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "config_error.h"
+
+#include <array>
+
+#include "config_parser.h"  // FormatLookupError
+
+namespace {
+
+constexpr std::array<std::string_view, static_cast<size_t>(ErrorCode::kLookupInvalidValue) + 1>
+        kErrorCodeNames = {
+                "open_file",
+                "invalid_type",
+                "invalid_vector_type",
+                "invalid_name",
+                "redefinition",
+                "expected_equals",
+                "expected_terminator",
+                "unterminated_string",
+                "string_not_quoted",
+                "vector_not_bracketed",
+                "invalid_value",
+                "invalid_element",
+                "include_path_not_quoted",
+                "include_not_found",
+                "include_cycle",
+                "include_error",
+                "too_many_includes",
+                "relative_include",
+                "lookup_not_found",
+                "lookup_wrong_type",
+                "lookup_invalid_value",
+};
+
+// Message of an error found in the source, without its location
+std::string FormatParsingError(const ConfigError& error, std::string_view text) {
+    const std::string quoted(text);
+    switch (error.code) {
+        case ErrorCode::kInvalidType:
+            return "invalid type: " + quoted;
+        case ErrorCode::kInvalidVectorType:
+            return "invalid type: " + error.type.ToString() + "[" + quoted;
+        case ErrorCode::kInvalidName:
+            return "invalid variable name: \"" + quoted + "\"";
+        case ErrorCode::kRedefinition:
+            return "redefinition of entity: " + quoted;
+        case ErrorCode::kExpectedEquals:
+            return "expected \"=\", encountered \"" + quoted + "\"";
+        case ErrorCode::kExpectedTerminator:
+            return std::string("expected ") + ConfigParser::kDeclarationTerminationChar + " at \"" +
+                   quoted + "\"";
+        case ErrorCode::kUnterminatedString:
+            return "unterminated string";
+        case ErrorCode::kStringNotQuoted:
+            return "string value must be enclosed in \"\"";
+        case ErrorCode::kVectorNotBracketed:
+            return "vector must be enclosed in []";
+        case ErrorCode::kInvalidValue:
+            return "could not parse `" + quoted + "` as type " + error.type.ToString();
+        case ErrorCode::kInvalidElement:
+            return "could not parse `" + quoted + "` as element of type " + error.type.ToString();
+        case ErrorCode::kIncludePathNotQuoted:
+            return "included path must be enclosed in \"\"";
+        case ErrorCode::kIncludeNotFound:
+            return "could not open included file: " + quoted;
+        case ErrorCode::kIncludeCycle:
+            return "include cycle: " + quoted;
+        case ErrorCode::kIncludeError:
+            return "error in included file: " + quoted;
+        case ErrorCode::kTooManyIncludes:
+            return "too many included files";
+        case ErrorCode::kRelativeInclude:
+            return "relative include path with no include directory: " + quoted;
+        default:
+            break;
+    }
+    return std::string();
+}
+
+}  // namespace
+
+std::string_view ErrorCodeName(ErrorCode code) {
+    return kErrorCodeNames[static_cast<size_t>(code)];
+}
+
+std::string FormatConfigError(const ConfigError& error,
+                              std::string_view text,
+                              const std::string& config_path) {
+    switch (error.code) {
+        case ErrorCode::kOpenFile:
+            return "Error opening file: " + config_path;
+        case ErrorCode::kLookupNotFound:
+            return FormatLookupError(LookupError::kNotFound, text, error.type, nullptr);
+        case ErrorCode::kLookupWrongType: {
+            const Variable found_variable{error.found_type, 0, 0};
+            return FormatLookupError(LookupError::kWrongType, text, error.type, &found_variable);
+        }
+        case ErrorCode::kLookupInvalidValue:
+            return FormatLookupError(LookupError::kInvalidValue, text, error.type, nullptr);
+        default:
+            break;
+    }
+    return "Parsing error in file " + config_path + ", line " + std::to_string(error.line) +
+           ", column " + std::to_string(error.column) + ": " + FormatParsingError(error, text);
+}
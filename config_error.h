@@ -0,0 +1,85 @@
+/* Structured records of the errors found while loading or reading a config.
+ *
+ * A ConfigParser records each error as a fixed-size ConfigError, with an error code and the source
+ * position and length of the offending token, rather than as a formatted message. The text that
+ * the message quotes (the token, a variable name or an included path) is appended to a buffer
+ * shared by all errors of the ConfigParser, so recording an error allocates nothing in the common
+ * case, and messages are only formatted when asked for (ConfigParser::FormatError, ErrorString).
+ *
+ * Loading stops at the first invalid declaration by default. With ParseOptions::collect_all_errors
+ * it resumes after the declaration's terminating ';' instead, so that a single load reports every
+ * invalid declaration, e.g. to check a batch of configs in CI:
+ *   ConfigParser config_parser("my_config.cfg", ParseOptions{.collect_all_errors = true});
+ *   for (const ConfigError& error : config_parser.Errors()) {
+ *       std::cerr << ErrorCodeName(error.code) << ": " << config_parser.FormatError(error) << "\n";
+ *   }
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "variable_index.h"
+
+enum class ErrorCode : uint8_t {
+    kOpenFile,            // the config file could not be read
+    // Declarations
+    kInvalidType,         // unknown type name
+    kInvalidVectorType,   // "[" after a type name not followed by "]"
+    kInvalidName,         // variable name missing or not a word
+    kRedefinition,        // variable already declared
+    kExpectedEquals,      // no "=" after the variable name
+    kExpectedTerminator,  // no ";" after the value
+    // Values
+    kUnterminatedString,
+    kStringNotQuoted,
+    kVectorNotBracketed,
+    kInvalidValue,        // value not of the declared type
+    kInvalidElement,      // vector element not of the declared type
+    // Include directives
+    kIncludePathNotQuoted,
+    kIncludeNotFound,
+    kIncludeCycle,
+    kIncludeError,        // the included config has errors
+    kTooManyIncludes,
+    kRelativeInclude,     // relative path in a config parsed from memory without a base directory
+    // Failed getter calls (see LookupError)
+    kLookupNotFound,
+    kLookupWrongType,
+    kLookupInvalidValue,
+};
+
+// Name of an error code for machine-readable output, e.g. "invalid_value"
+std::string_view ErrorCodeName(ErrorCode code);
+
+struct ConfigError {
+    ErrorCode code = ErrorCode::kOpenFile;
+    // Declared type of an invalid value, or the type expected by a failed lookup
+    VariableType type{};
+    // Type of the variable found by a lookup of the wrong type
+    VariableType found_type{};
+    // 1-based position of the offending token in the source, or line 0 if the error has none (an
+    // unreadable file, or a failed lookup)
+    uint32_t line = 0;
+    uint32_t column = 0;
+    // Span of the offending token in the source: [offset, offset + size)
+    size_t offset = 0;
+    size_t size = 0;
+    // Span of the name of the variable whose declaration has the error, or an empty span if the
+    // error comes before a valid name (e.g. an invalid type) or is not in a declaration
+    size_t key_offset = 0;
+    size_t key_size = 0;
+    // Text quoted by the message, as a slice of the error text of the ConfigParser that recorded
+    // the error
+    uint32_t text_begin = 0;
+    uint32_t text_size = 0;
+};
+
+// Formats the message of an error recorded while loading config_path, where text is the text the
+// error quotes, e.g. "Parsing error in file my_config.cfg, line 3, column 9: invalid type: in"
+std::string FormatConfigError(const ConfigError& error,
+                              std::string_view text,
+                              const std::string& config_path);
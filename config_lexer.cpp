@@ -0,0 +1,201 @@
+#include "config_lexer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+
+// Kind of the token starting with a given character
+constexpr std::array<TokenKind, 256> MakeTokenKindTable() {
+    std::array<TokenKind, 256> table{};
+    table.fill(TokenKind::kWord);
+    table[static_cast<unsigned char>(Lexer::kQuoteChar)] = TokenKind::kString;
+    table['='] = TokenKind::kEquals;
+    table['['] = TokenKind::kOpenBracket;
+    table[']'] = TokenKind::kCloseBracket;
+    table[','] = TokenKind::kComma;
+    table[';'] = TokenKind::kSemicolon;
+    return table;
+}
+
+constexpr std::array<TokenKind, 256> kTokenKindTable = MakeTokenKindTable();
+
+// Returns a mask with bits [begin, end) set, for 0 <= begin <= end <= 64
+inline uint64_t RangeMask(size_t begin, size_t end) {
+    const uint64_t below_end = (end >= 64) ? ~uint64_t{0} : ((uint64_t{1} << end) - 1);
+    return below_end & ~((uint64_t{1} << begin) - 1);
+}
+
+}  // namespace
+
+Lexer::Lexer(std::string_view input, const SourceLocation& origin)
+    : _input(input),
+      _span_count{0},
+      _next_span{0},
+      _scan_offset{0},
+      _scan_mode{ScanMode::kNormal},
+      _previous_is_boundary{true},
+      _in_word{false},
+      _token_start{0},
+      _consumed_end{0},
+      _origin(origin),
+      _last_location{0, 1, 1} {}
+
+Token Lexer::Next() {
+    const Token token = Peek();
+    if (token.kind != TokenKind::kEnd) {
+        ++_next_span;
+        _consumed_end = static_cast<size_t>(token.text.data() - _input.data()) + token.text.size();
+    }
+    return token;
+}
+
+Token Lexer::Peek() {
+    if (_next_span == _span_count) Refill();
+    if (_next_span == _span_count) {
+        return Token{TokenKind::kEnd, _input.substr(_input.size())};
+    }
+    const TokenSpan& span = _spans[_next_span];
+    const std::string_view text(_input.data() + span.start, span.end - span.start);
+    const TokenKind kind = kTokenKindTable[static_cast<unsigned char>(text[0])];
+    if ((kind == TokenKind::kString) && (text.size() == 1)) return Token{TokenKind::kError, text};
+    return Token{kind, text};
+}
+
+void Lexer::Seek(size_t offset) {
+    _span_count = 0;
+    _next_span = 0;
+    _scan_offset = offset;
+    _consumed_end = offset;
+    _scan_mode = ScanMode::kNormal;
+    _previous_is_boundary = true;
+    _in_word = false;
+}
+
+SourceLocation Lexer::Locate(const Token& token) {
+    const size_t offset = static_cast<size_t>(token.text.data() - _input.data());
+    if (offset < _last_location.offset) _last_location = SourceLocation{0, 1, 1};
+    // Count newlines between the last located position and this token, a block at a time
+    size_t line = _last_location.line;
+    size_t line_start = _last_location.offset - (_last_location.column - 1);
+    for (size_t position = _last_location.offset; position < offset;
+         position += kStructuralBlockSize) {
+        const size_t block_size = std::min(offset - position, kStructuralBlockSize);
+        const uint64_t newlines =
+                ClassifyBlock(_input.data() + position, block_size).newline &
+                RangeMask(0, block_size);
+        if (newlines != 0) {
+            line += std::popcount(newlines);
+            line_start = position + (63 - std::countl_zero(newlines)) + 1;
+        }
+    }
+    _last_location = SourceLocation{offset, line, offset - line_start + 1};
+    // The first line of the input continues the origin's line
+    const size_t column = (line == 1) ? (_origin.column + _last_location.column - 1)
+                                      : _last_location.column;
+    return SourceLocation{_origin.offset + offset, _origin.line + line - 1, column};
+}
+
+void Lexer::Refill() {
+    _span_count = 0;
+    _next_span = 0;
+    while ((_span_count < kMinBufferedTokens) && (_scan_offset < _input.size())) {
+        ScanBlock(_scan_offset);
+        _scan_offset += kStructuralBlockSize;
+        if (_scan_offset >= _input.size()) FinishScan();
+    }
+}
+
+void Lexer::ScanBlock(size_t block_start) {
+    const size_t block_size = std::min(_input.size() - block_start, kStructuralBlockSize);
+    const StructuralMasks masks = ClassifyBlock(_input.data() + block_start, block_size);
+    const uint64_t in_block = RangeMask(0, block_size);  // bits beyond the input are padding
+    // Word boundaries follow from character classes alone
+    const uint64_t non_word = masks.space | masks.delimiter;
+    const uint64_t follows_non_word = (non_word << 1) | uint64_t{_previous_is_boundary};
+    const uint64_t word_starts = ~non_word & follows_non_word & in_block;
+    uint64_t word_ends = non_word & ~follows_non_word & in_block;
+    _previous_is_boundary = (non_word >> 63) != 0;
+    if ((_scan_mode != ScanMode::kNormal) || ((masks.quote | masks.comment) != 0)) {
+        ScanBlockEvents(block_start, masks, word_starts, word_ends, in_block);
+        return;
+    }
+    // Fast path: every delimiter is a single-character token, and each word start pairs with the
+    // next word end
+    if (_in_word && (word_ends != 0)) {  // finish the word continued from the previous block
+        AddSpan(_token_start, block_start + std::countr_zero(word_ends));
+        word_ends &= word_ends - 1;
+        _in_word = false;
+    }
+    uint64_t starts = word_starts | (masks.delimiter & in_block);
+    while (starts != 0) {
+        const int start_index = std::countr_zero(starts);
+        starts &= starts - 1;
+        if ((word_starts >> start_index) & 1) {
+            if (word_ends == 0) {  // word continues into the next block
+                _token_start = block_start + start_index;
+                _in_word = true;
+                break;
+            }
+            AddSpan(block_start + start_index, block_start + std::countr_zero(word_ends));
+            word_ends &= word_ends - 1;
+        } else {
+            AddSpan(block_start + start_index, block_start + start_index + 1);
+        }
+    }
+}
+
+void Lexer::ScanBlockEvents(size_t block_start,
+                            const StructuralMasks& masks,
+                            uint64_t word_starts,
+                            uint64_t word_ends,
+                            uint64_t in_block) {
+    // Visit each structural position in order. Word boundaries inside strings and comments are
+    // skipped based on the scan mode.
+    uint64_t events = word_starts | word_ends | ((masks.delimiter | masks.newline) & in_block);
+    while (events != 0) {
+        const int bit_index = std::countr_zero(events);
+        const uint64_t bit = uint64_t{1} << bit_index;
+        events &= events - 1;
+        const size_t position = block_start + bit_index;
+        if (_scan_mode == ScanMode::kString) {
+            if (masks.quote & bit) {  // closing quote
+                AddSpan(_token_start, position + 1);
+                _scan_mode = ScanMode::kNormal;
+            }
+            continue;
+        } else if (_scan_mode == ScanMode::kComment) {
+            if (masks.newline & bit) _scan_mode = ScanMode::kNormal;
+            continue;
+        }
+        if ((word_ends & bit) && _in_word) {
+            AddSpan(_token_start, position);
+            _in_word = false;
+        }
+        if (word_starts & bit) {
+            _token_start = position;
+            _in_word = true;
+        } else if (masks.delimiter & bit) {
+            const char ch = _input[position];
+            if (ch == kQuoteChar) {
+                _token_start = position;
+                _scan_mode = ScanMode::kString;
+            } else if (ch == kCommentChar) {
+                _scan_mode = ScanMode::kComment;
+            } else {
+                AddSpan(position, position + 1);
+            }
+        }
+    }
+}
+
+void Lexer::FinishScan() {
+    if (_in_word) {  // word running to the end of the input
+        AddSpan(_token_start, _input.size());
+        _in_word = false;
+    } else if (_scan_mode == ScanMode::kString) {  // report only the opening quote
+        AddSpan(_token_start, _token_start + 1);
+    }
+    _scan_mode = ScanMode::kNormal;
+}
@@ -0,0 +1,127 @@
+/* Single-pass lexer for the config format.
+ *
+ * Scans the raw input buffer once from front to back, skipping whitespace and comments and
+ * emitting tokens as slices of the input (no characters are copied). Since tokens point into the
+ * original input, the true line and column of any token can be recovered with Locate, e.g. for
+ * error messages; this is computed on demand so the hot path does no line bookkeeping.
+ *
+ * Tokens are found in batches: the input is classified 64 bytes at a time (see
+ * structural_scanner.h), and the boundaries of all tokens in a block are decoded directly from
+ * its structural masks with bit operations, rather than by testing characters one at a time.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "structural_scanner.h"
+
+enum class TokenKind {
+    kWord,          // run of characters other than whitespace, quotes, comments and punctuation
+    kString,        // double-quoted string, including the enclosing quotes
+    kEquals,        // =
+    kOpenBracket,   // [
+    kCloseBracket,  // ]
+    kComma,         // ,
+    kSemicolon,     // ;
+    kEnd,           // end of input
+    kError,         // unterminated string
+};
+
+// Position within the input: byte offset, and 1-based line and column numbers
+struct SourceLocation {
+    size_t offset;
+    size_t line;
+    size_t column;
+};
+
+struct Token {
+    TokenKind kind;
+    std::string_view text;  // slice of the input buffer
+};
+
+class Lexer {
+  public:
+    // Syntax constants
+    static constexpr char kCommentChar = '#';
+    static constexpr char kQuoteChar = '"';
+
+    // The input buffer must outlive the Lexer and any tokens it returns. If the input is a piece of
+    // a larger source, origin gives the location of its first character, so that Locate reports
+    // positions within the whole source.
+    explicit Lexer(std::string_view input, const SourceLocation& origin = SourceLocation{0, 1, 1});
+
+    // Returns the next token, advancing past it
+    Token Next();
+    // Returns the next token without advancing past it
+    Token Peek();
+    // Discards any buffered tokens and resumes scanning at offset, which must be just after a
+    // token (not inside a word, string or comment)
+    void Seek(size_t offset);
+
+    // Returns the source location of a token returned by this Lexer. Locating tokens in increasing
+    // order of position is fast, since counting resumes from the last located position.
+    SourceLocation Locate(const Token& token);
+    // Returns the offset in the source of a token returned by this Lexer, without locating it
+    size_t Offset(const Token& token) const {
+        return _origin.offset + static_cast<size_t>(token.text.data() - _input.data());
+    }
+
+    // Returns the offset in the input just past the last token returned by Next, or the offset
+    // last given to Seek if that came after it
+    size_t ConsumedEnd() const { return _consumed_end; }
+
+    std::string_view Input() const { return _input; }
+
+  private:
+    // Token position within the input. The kind is derived from the first character when the
+    // token is returned, with a single opening quote denoting an unterminated string.
+    struct TokenSpan {
+        size_t start;
+        size_t end;
+    };
+
+    // What the scanner is inside of, carried across blocks
+    enum class ScanMode {
+        kNormal,
+        kString,
+        kComment,
+    };
+
+    // Tokens are buffered until at least kMinBufferedTokens are found; since a block adds at most
+    // one token per byte plus one continued from the previous block, this bounds the buffer size.
+    static constexpr size_t kMinBufferedTokens = 64;
+    static constexpr size_t kSpanBufferSize = kMinBufferedTokens + 2 * kStructuralBlockSize;
+
+    // Scans further blocks of input, buffering the tokens found in _spans
+    void Refill();
+    void AddSpan(size_t start, size_t end) { _spans[_span_count++] = TokenSpan{start, end}; }
+    // Decodes the tokens in the 64-byte block starting at block_start from its structural masks
+    void ScanBlock(size_t block_start);
+    // Slow path of ScanBlock for blocks containing strings or comments
+    void ScanBlockEvents(size_t block_start,
+                         const StructuralMasks& masks,
+                         uint64_t word_starts,
+                         uint64_t word_ends,
+                         uint64_t in_block);
+    // Handles reaching the end of the input, completing or reporting any unfinished token
+    void FinishScan();
+
+    std::string_view _input;
+    // Tokens found by the scanner but not yet returned, in order
+    std::array<TokenSpan, kSpanBufferSize> _spans;
+    size_t _span_count;
+    size_t _next_span;
+    // Scanner state
+    size_t _scan_offset;  // start of the next block to scan
+    ScanMode _scan_mode;
+    bool _previous_is_boundary;  // whether the character before _scan_offset ends a word
+    bool _in_word;
+    size_t _token_start;  // start of the word or string being scanned
+    size_t _consumed_end;  // see ConsumedEnd
+    SourceLocation _origin;  // location of the start of the input within the whole source
+    SourceLocation _last_location;  // checkpoint for Locate, relative to the input
+};
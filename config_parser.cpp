@@ -1,13 +1,26 @@
 #include "config_parser.h"
 
 #include <algorithm>
+#include <bit>
 #include <cctype>  // std::isspace
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
+
+#include "binary_cache.h"
+#include "config_lexer.h"
+#include "mapped_file.h"
+#include "numeric_parsing.h"
+#include "parse_cache.h"
+#include "structural_scanner.h"
 
 const char ConfigParser::kDeclarationTerminationChar = ';';
 const std::string ConfigParser::kCommentPrefix = "#";
+const std::string ConfigParser::kIncludeKeyword = "include";
+const std::string ConfigParser::kBufferSourceName = "<buffer>";
+const std::string ConfigParser::kBinaryCacheSuffix = ".cache";
 
 const std::string ConfigParser::kStringTypeString = "string";
 const std::string ConfigParser::kIntTypeString = "int";
@@ -32,213 +45,75 @@ const std::unordered_map<std::string, ExpressionType> ConfigParser::kTypeStringM
         {ConfigParser::kDoubleTypeString, ExpressionType::kDouble},
         {ConfigParser::kBoolTypeString, ExpressionType::kBool}};
 
-// TODO: line numbers in error messages are not original line numbers in config file,
-// because whitespace/comment stripping removes lines and linebreaks
-
 namespace {
 
-/** String manipulation helper methods **/
-
-// Trims from left, in-place
-void Ltrim(std::string& s) {
-    // Note: argument to std::isspace should be unsigned char to prevent undefined behavior
-    auto not_space = [](unsigned char ch) { return !std::isspace(ch); };
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), not_space));
+// Number of threads to use for a ParseOptions::thread_count, where 0 means one per hardware thread
+size_t ResolveThreadCount(size_t thread_count) {
+    return (thread_count != 0) ? thread_count : std::max(1u, std::thread::hardware_concurrency());
 }
 
-// Trims from right, in-place
-void Rtrim(std::string& s) {
-    auto not_space = [](unsigned char ch) { return !std::isspace(ch); };
-    // Note: .base() gets forward iterator from reverse
-    s.erase(std::find_if(s.rbegin(), s.rend(), not_space).base(), s.end());
+// Reads the entire contents of a file into a string with a single copy
+bool ReadFile(const std::string& path, std::string* contents) {
+    std::ifstream input_filestream(path, std::ios::binary | std::ios::ate);
+    if (!input_filestream.is_open()) return false;
+    const std::streamsize size = input_filestream.tellg();
+    if (size < 0) return false;
+    contents->resize(static_cast<size_t>(size));
+    input_filestream.seekg(0);
+    return static_cast<bool>(input_filestream.read(contents->data(), size));
 }
 
-// Trims from both sides, in-place
-void Trim(std::string& s) {
-    Ltrim(s);
-    Rtrim(s);
-}
-
-// Splits string by delim, optionally retaining empty strings (caused by consecutive delim chars)
-std::vector<std::string> SplitString(const std::string& input_string,
-                                     const char delim,
-                                     bool retain_empty = false) {
-    std::vector<std::string> output_vector;
-    size_t start_i = 0;
-    size_t found_i = 0;  // dummy initialization to start while loop
-    size_t len;
-    while (found_i != std::string::npos) {
-        found_i = input_string.find(delim, start_i);
-        len = (found_i == std::string::npos) ? input_string.length() - start_i : found_i - start_i;
-        if (len > 0) {  // non-consecutive delimiters
-            output_vector.push_back(input_string.substr(start_i, found_i - start_i));
-        } else if (retain_empty) {
-            output_vector.push_back(std::string(""));
-        }
-        start_i = found_i + 1;
-    }
-    return output_vector;
-}
-
-/** Parsing helper methods **/
-
-// Checks whether or not the given position in the string is the start of a comment
-bool IsCommentStart(const std::string& input_string, size_t start_index) {
-    size_t len = ConfigParser::kCommentPrefix.size();
-    return input_string.substr(start_index, len) == ConfigParser::kCommentPrefix;
-}
-
-std::string RemoveComments(const std::string& input_string) {
-    bool in_comment = false;
-    bool in_quotes = false;
-    std::string output_string;
-    for (size_t i = 0; i < input_string.size(); ++i) {
-        const char ch = input_string[i];
-        if (in_comment) {  // skip commented out characters
-            if (ch == '\n') in_comment = false;
-            continue;
-        } else if (in_quotes) {  // copy in-quotes characters directly
-            if (ch == '"') in_quotes = false;
-            output_string += ch;
-        } else if (IsCommentStart(input_string, i)) {  // start comment
-            in_comment = true;
-        } else if (ch == '"') {  // start quotes
-            in_quotes = true;
-            output_string += ch;  // copy quote character as well (unlike comment)
-        } else {                  // any non-special case, copy character to output
-            output_string += ch;
-        }
-    }
-    return output_string;
-}
-
-// Converts any sequence of consecutive whitespace into a single space (only if outside quotes)
-// Should be called after comments are removed, since comment parsing is whitespace dependent
-std::string CleanWhitespace(const std::string& input_string) {
-    bool in_quotes = false;
-    bool in_whitespace = false;
-    std::string output_string;
-    for (const char ch : input_string) {
-        if (in_quotes) {  // copy in-quotes characters directly
-            if (ch == '"') in_quotes = false;
-            output_string += ch;
-        } else if (in_whitespace) {  // when in whitespace, only check for end of whitespace
-            if (!ConfigParser::is_space(ch)) {  // end whitespace
-                in_whitespace = false;
-                output_string += ch;
-            }
-        } else if (ConfigParser::is_space(ch)) {  // start whitespace
-            in_whitespace = true;
-            output_string += ' ';
-        } else {  // any non-special case, copy character to output
-            output_string += ch;
-        }
-    }
-    return output_string;
-}
-
-/* Preprocessing to clean up and normalize the input:
- *  - Removes comments (starting from comment prefix, up to newline char)
- *  - Cleans up any whitespace (turning blocks of whitespace into a single space)
- *  - Splits into a list of declarations (by splitting at semicolons)
- *  - Trims whitespace (from left and right ends) of each declaration
- */
-std::vector<std::string> PreprocessInput(const std::ifstream& input_filestream) {
-    // Read file stream into input string stream and get string
-    std::stringstream ss;
-    ss << input_filestream.rdbuf();
-    std::string input_string = ss.str();
-    // Clean up formatting
-    std::string cleaned_input = CleanWhitespace(RemoveComments(input_string));
-    // Break into lines and trim excess whitespace
-    std::vector<std::string> declarations =
-            SplitString(cleaned_input, ConfigParser::kDeclarationTerminationChar);
-    for (std::string& declaration : declarations) Trim(declaration);
-    // Remove empty lines
-    declarations.erase(std::remove(declarations.begin(), declarations.end(), ""),
-                       declarations.end());
-    return declarations;
-}
-
-// Advances the current_index until it points to a character for which delimeter_predicate
-// returns true, then returns the string up to (but not including) that character.
-std::string ReadNextToken(const std::string& input_string,
-                          size_t* current_index,
-                          bool delimeter_predicate(char c)) {
-    std::string token;
-    for (/* current_index */; *current_index < input_string.size(); ++(*current_index)) {
-        if (delimeter_predicate(input_string[*current_index])) {
-            break;
-        }
-        token += input_string[*current_index];
-    }
-    return token;
-}
-
-// Advances current_index to correspond to the next non-whitespace character in input_string
-void SkipWhitespace(const std::string& input_string, size_t* current_index) {
-    auto not_space = [](char ch) { return !ConfigParser::is_space(ch); };
-    if (ConfigParser::is_space(input_string[*current_index])) {
-        ReadNextToken(input_string, current_index, not_space);
+// Options of a load of the config file at config_path, whose relative includes resolve against
+// the file's directory unless options give another
+ParseOptions FileOptions(const std::string& config_path, ParseOptions options) {
+    if (options.include_directory.empty()) {
+        const std::filesystem::path directory = std::filesystem::path(config_path).parent_path();
+        options.include_directory = directory.empty() ? "." : directory.string();
     }
+    return options;
 }
 
 /** Single value parsing methods **/
 
-std::string ParseString(const std::string& value_string, bool* error_flag) {
+// Returns the contents of a quoted string, which are stored without any unescaping
+std::string_view ParseString(std::string_view value_string, bool* error_flag) {
     *error_flag = false;
     if ((value_string.size() < 2) || (value_string[0] != '"') || (value_string.back() != '"')) {
         *error_flag = true;
-        return "";
+        return std::string_view();
     }
-    std::string string_contents(value_string.begin() + 1, value_string.end() - 1);
+    std::string_view string_contents = value_string.substr(1, value_string.size() - 2);
     if (string_contents.find('"') != std::string::npos) {  // string should not contain any quotes
         *error_flag = true;
     }
     return string_contents;
 }
 
-int ParseInt(const std::string& value_string, bool* error_flag) {
-    *error_flag = false;
-    try {
-        return std::stoi(value_string);
-    } catch (...) {
-        *error_flag = true;
-        return 0;
-    }
+int ParseInt(std::string_view value_string, bool* error_flag) {
+    int value = 0;
+    *error_flag = !ParseNumber(value_string, &value);
+    return value;
 }
 
-size_t ParseUint(const std::string& value_string, bool* error_flag) {
-    *error_flag = false;
-    try {
-        return std::stoull(value_string);
-    } catch (...) {
-        *error_flag = true;
-        return 0;
-    }
+size_t ParseUint(std::string_view value_string, bool* error_flag) {
+    size_t value = 0;
+    *error_flag = !ParseNumber(value_string, &value);
+    return value;
 }
 
-float ParseFloat(const std::string& value_string, bool* error_flag) {
-    *error_flag = false;
-    try {
-        return std::stof(value_string);
-    } catch (...) {
-        *error_flag = true;
-        return 0;
-    }
+float ParseFloat(std::string_view value_string, bool* error_flag) {
+    float value = 0;
+    *error_flag = !ParseNumber(value_string, &value);
+    return value;
 }
 
-double ParseDouble(const std::string& value_string, bool* error_flag) {
-    *error_flag = false;
-    try {
-        return std::stod(value_string);
-    } catch (...) {
-        *error_flag = true;
-        return 0;
-    }
+double ParseDouble(std::string_view value_string, bool* error_flag) {
+    double value = 0;
+    *error_flag = !ParseNumber(value_string, &value);
+    return value;
 }
 
-bool ParseBool(const std::string& value_string, bool* error_flag) {
+bool ParseBool(std::string_view value_string, bool* error_flag) {
     *error_flag = false;
     if (value_string == "true") {
         return true;
@@ -249,506 +124,1529 @@ bool ParseBool(const std::string& value_string, bool* error_flag) {
     return false;
 }
 
-/** Vector parsing methods **/
-
-// Forward declaration to use in ParseXxxVector methods
-std::vector<std::string> SplitVectorExpression(const std::string& vector_string,
-                                               const std::string& type_string,
-                                               bool* error_flag);
-
-std::vector<std::string> ParseStringVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kStringTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<std::string> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseString(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-std::vector<int> ParseIntVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kIntTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<int> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseInt(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-std::vector<size_t> ParseUintVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kUintTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<size_t> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseInt(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-std::vector<float> ParseFloatVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kFloatTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<float> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseFloat(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-std::vector<double> ParseDoubleVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kDoubleTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<double> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseDouble(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-std::vector<bool> ParseBoolVector(const std::string& expression_string, bool* error_flag) {
-    static const std::string type_string = ConfigParser::kBoolTypeString;
-    // Split into individual values' expressions
-    std::vector<std::string> value_strings =
-            SplitVectorExpression(expression_string, type_string, error_flag);
-    if (*error_flag) return {};
-    // Parse each value
-    std::vector<bool> parsed_values;
-    for (const std::string& value_string : value_strings) {
-        parsed_values.push_back(ParseBool(value_string, error_flag));
-        if (*error_flag) break;  // break whenever error occurs to preserve error_flag value
-    }
-    return parsed_values;
-}
-
-// Breaks a single string containing a vector expression into its component pieces
-// Example: "[1, 2, 3]" --> std::vector containing ["1", "2", "3"]
-std::vector<std::string> SplitVectorExpression(const std::string& vector_string,
-                                               const std::string& type_string,
-                                               bool* error_flag) {
-    *error_flag = false;
-    std::vector<std::string> value_strings;
-    // Handle string and non-string types separately
-    if (type_string == ConfigParser::kStringTypeString) {
-        bool in_quotes = false;
-        bool expect_comma = false;
-        bool expect_new_value = true;  // expect new value or whitespace
-        std::string current_string = "";
-        for (size_t i = 1; i + 1 < vector_string.size(); ++i) {  // skip opening and closing []
-            const char ch = vector_string[i];
-            current_string += ch;
-            if (expect_comma && (ch == ',')) {  // expected and found comma
-                expect_comma = false;
-                expect_new_value = true;
-            } else if (expect_comma) {  // expected but didn't find comma
-                *error_flag = true;
-                break;
-            } else if (expect_new_value && (ch == '"')) {  // start new value
-                expect_new_value = false;
-                in_quotes = true;
-                current_string = std::string{} + ch;
-            } else if (expect_new_value && ConfigParser::is_space(ch)) {
-                ;  // do nothing, just skipping through whitespace
-            } else if (expect_new_value && !ConfigParser::is_space(ch)) {
-                *error_flag = true;
-                break;
-            } else if (in_quotes && (ch == '"')) {  // end quotes, end current value
-                in_quotes = false;
-                expect_comma = true;
-                value_strings.push_back(std::move(current_string));
-                current_string = "";
-            } else if (in_quotes && (ch != '"')) {
-                ;     // do nothing, just staying in quotes
-            } else {  // the above checks cover all allowed cases, otherwise there is an error
-                *error_flag = true;
-                break;
-            }
-        }
-    } else {  // non-string type, value separated by comma then optional whitespace
-        size_t index = 1;
-        auto is_comma = [](char c) { return c == ','; };
-        while (index + 1 < vector_string.size()) {  // skip opening and closing []
-            std::string value_string = ReadNextToken(vector_string, &index, is_comma);
-            if (std::find_if(value_string.begin(), value_string.end(), ConfigParser::is_space) !=
-                value_string.end()) {  // true iff there is whitespace in value_string
-                *error_flag = true;
-                break;
-            } else if (value_string.back() == ']') {
-                value_string.pop_back();  // remove last closing bracket
-            }
-            value_strings.push_back(std::move(value_string));
-            ++index;  // advance past the comma we just found
-            SkipWhitespace(vector_string, &index);
-        }
-    }
-    // DEBUG ONLY
-    //    std::cout << "******** SplitVectorExpression *********" << std::endl;
-    //    std::cout << "Input: " << vector_string << std::endl;
-    //    std::cout << "----------------------------------------" << std::endl;
-    //    for (const std::string& line : value_strings) std::cout << line << std::endl;
-    //    std::cout << "****************************************" << std::endl;
-    return value_strings;
+// Stores a successfully parsed value of config type T, returning false instead if *error_flag
+// was set
+template <typename T, typename Value>
+bool StoreParsedValue(const Value& value,
+                      const bool* error_flag,
+                      ValueStore* values,
+                      size_t* slot) {
+    if (*error_flag) return false;
+    *slot = values->Add<T>(value);
+    return true;
 }
 
-bool CheckParseValue(const std::string& value_string, const std::string& type_string) {
+// Parses a single value and appends it to values, storing the value's index in *slot.
+// Returns false if the value could not be parsed as the given type.
+bool ParseValue(std::string_view value_string,
+                ExpressionType type,
+                ValueStore* values,
+                size_t* slot) {
     bool error_flag = true;  // default to error if type is unmatched in switch statement
-    const ExpressionType type = ConfigParser::kTypeStringMap.at(type_string);
     switch (type) {
-        case ExpressionType::kString: {
-            ParseString(value_string, &error_flag);
+        case ExpressionType::kString:
+            return StoreParsedValue<std::string>(
+                    ParseString(value_string, &error_flag), &error_flag, values, slot);
+        case ExpressionType::kInt:
+            return StoreParsedValue<int>(
+                    ParseInt(value_string, &error_flag), &error_flag, values, slot);
+        case ExpressionType::kUint:
+            return StoreParsedValue<size_t>(
+                    ParseUint(value_string, &error_flag), &error_flag, values, slot);
+        case ExpressionType::kFloat:
+            return StoreParsedValue<float>(
+                    ParseFloat(value_string, &error_flag), &error_flag, values, slot);
+        case ExpressionType::kDouble:
+            return StoreParsedValue<double>(
+                    ParseDouble(value_string, &error_flag), &error_flag, values, slot);
+        case ExpressionType::kBool:
+            return StoreParsedValue<bool>(
+                    ParseBool(value_string, &error_flag), &error_flag, values, slot);
+    }
+    return false;
+}
+
+// Converts a type name to its ExpressionType, returning false if it is not a valid type name
+bool ParseTypeString(std::string_view type_string, ExpressionType* type) {
+    // Each type name starts with a different character, so at most one comparison is needed
+    ExpressionType candidate;
+    switch (type_string.empty() ? '\0' : type_string[0]) {
+        case 's':
+            candidate = ExpressionType::kString;
             break;
-        }
-        case ExpressionType::kInt: {
-            ParseInt(value_string, &error_flag);
+        case 'i':
+            candidate = ExpressionType::kInt;
             break;
-        }
-        case ExpressionType::kUint: {
-            ParseUint(value_string, &error_flag);
+        case 'u':
+            candidate = ExpressionType::kUint;
             break;
-        }
-        case ExpressionType::kFloat: {
-            ParseFloat(value_string, &error_flag);
+        case 'f':
+            candidate = ExpressionType::kFloat;
             break;
-        }
-        case ExpressionType::kDouble: {
-            ParseDouble(value_string, &error_flag);
+        case 'd':
+            candidate = ExpressionType::kDouble;
             break;
-        }
-        case ExpressionType::kBool: {
-            ParseBool(value_string, &error_flag);
+        case 'b':
+            candidate = ExpressionType::kBool;
             break;
-        }
+        default:
+            return false;
     }
-    return !error_flag;  // return true if can parse successfully, false otherwise
+    if (type_string != ConfigParser::kValidTypeStrings[static_cast<size_t>(candidate)]) {
+        return false;
+    }
+    *type = candidate;
+    return true;
 }
 
-bool CheckParseVector(const std::string& vector_string, const std::string& type_string) {
-    bool error_flag = true;  // default to error if type is unmatched in switch statement
-    const ExpressionType type = ConfigParser::kTypeStringMap.at(type_string);
-    switch (type) {
-        case ExpressionType::kString: {
-            ParseStringVector(vector_string, &error_flag);
-            break;
+/** Parse statistics **/
+
+uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - start)
+                                         .count());
+}
+
+// Adds the wall time of its scope to *nanoseconds, unless nanoseconds is null (stats disabled)
+class PhaseTimer {
+  public:
+    explicit PhaseTimer(uint64_t* nanoseconds) : _nanoseconds{nanoseconds} {
+        if (_nanoseconds != nullptr) _start = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (_nanoseconds != nullptr) *_nanoseconds += NanosecondsSince(_start);
+    }
+
+  private:
+    uint64_t* _nanoseconds;
+    std::chrono::steady_clock::time_point _start;
+};
+
+/** Declaration boundaries **/
+
+// Inputs are only split for parallel parsing into ranges of at least this many bytes
+constexpr size_t kMinBytesPerDeclarationRange = size_t{1} << 20;
+
+// Returns the position of the first character of [begin, end) of contents that is neither
+// whitespace nor in a comment, or end if there is none
+size_t SkipSpaceAndComments(std::string_view contents, size_t begin, size_t end) {
+    size_t position = begin;
+    while (position < end) {
+        if (contents[position] == Lexer::kCommentChar) {
+            position = contents.find('\n', position);
+            if (position == std::string_view::npos) return end;
+        } else if (!std::isspace(static_cast<unsigned char>(contents[position]))) {
+            return position;
         }
-        case ExpressionType::kInt: {
-            ParseIntVector(vector_string, &error_flag);
-            break;
+        ++position;
+    }
+    return end;
+}
+
+// Returns the offsets splitting contents into up to range_count ranges of similar size, each
+// ending just after a declaration-terminating ';' (or at the end of the input). The first offset is
+// 0 and the last is contents.size(). Whitespace and comments after the last declaration are left
+// to the range before them, so that a single large declaration is not split into ranges (and its
+// vector can be split into chunks instead).
+std::vector<size_t> FindDeclarationBoundaries(std::string_view contents, size_t range_count) {
+    std::vector<size_t> boundaries = {0};
+    DeclarationScanner scanner;
+    for (size_t i = 1; i < range_count; ++i) {
+        const size_t target = std::max(boundaries.back(), i * contents.size() / range_count);
+        const size_t terminator = scanner.FindTerminator(contents, boundaries.back(), target);
+        if (terminator == DeclarationScanner::kNotFound) break;
+        boundaries.push_back(terminator + 1);
+    }
+    if ((boundaries.size() > 1) &&
+        (SkipSpaceAndComments(contents, boundaries.back(), contents.size()) == contents.size())) {
+        boundaries.pop_back();
+    }
+    if (boundaries.back() != contents.size()) boundaries.push_back(contents.size());
+    return boundaries;
+}
+
+/** Vector parsing methods **/
+
+// Scratch memory for the temporaries of parsing a range of declarations keeps blocks of up to this
+// size for reuse by later declarations
+const std::pmr::pool_options kScratchPoolOptions{0, size_t{1} << 20};
+
+// Number of declarations of the previous version that Reparse compares a declaration with, after
+// the last one it matched, before looking it up among all of them
+constexpr size_t kReparseSearchWindow = 8;
+
+// Reads the elements of a vector expression following its opening '[' token, up to and including
+// the closing ']', and appends the parsed vector of T to values. The elements are collected in
+// scratch memory, so that the stored vector is allocated once at its final size. On failure,
+// returns false with *token set to the token that could not be parsed.
+template <typename T, typename Element>
+bool ParseVectorElements(Lexer* lexer,
+                         TokenKind element_kind,
+                         Element parse_element(std::string_view, bool*),
+                         std::pmr::memory_resource* scratch,
+                         ValueStore* values,
+                         size_t* slot,
+                         Token* token) {
+    std::pmr::vector<Element> elements(scratch);
+    *token = lexer->Next();
+    bool expect_element = (token->kind != TokenKind::kCloseBracket);  // allow empty vector
+    while (expect_element) {
+        bool error_flag = (token->kind != element_kind);
+        if (error_flag) return false;
+        elements.push_back(parse_element(token->text, &error_flag));
+        if (error_flag) return false;
+        *token = lexer->Next();
+        if (token->kind == TokenKind::kComma) {
+            *token = lexer->Next();
+        } else if (token->kind == TokenKind::kCloseBracket) {
+            expect_element = false;
+        } else {
+            return false;
         }
-        case ExpressionType::kUint: {
-            ParseUintVector(vector_string, &error_flag);
-            break;
+    }
+    *slot = values->Add<std::vector<T>>(elements.begin(), elements.end());
+    return true;
+}
+
+/** Bulk numeric vector parsing **/
+
+// Numeric vectors spanning at least this many bytes per thread are parsed in parallel
+constexpr size_t kMinBytesPerParallelChunk = size_t{1} << 18;
+
+// Returns an upper bound on the number of elements in a comma-separated list, by counting
+// delimiters a block at a time. Delimiters other than commas make the list invalid, so the bound
+// is exact for any list that parses successfully.
+size_t MaxElementCount(std::string_view list) {
+    size_t delimiter_count = 0;
+    for (size_t i = 0; i < list.size(); i += kStructuralBlockSize) {
+        const size_t block_size = std::min(list.size() - i, kStructuralBlockSize);
+        const StructuralMasks masks = ClassifyBlock(list.data() + i, block_size);
+        delimiter_count += std::popcount(masks.delimiter);  // padding is whitespace
+    }
+    return delimiter_count + 1;
+}
+
+// Parses a non-empty comma-separated list of numbers into out, which has room for capacity
+// elements. The character just past the end of the list must be its terminating ',' or ']'.
+// On failure, returns false with *error_token set to the token that could not be parsed.
+template <typename T>
+bool ParseNumericList(std::string_view list,
+                      T* out,
+                      size_t capacity,
+                      size_t* count,
+                      Token* error_token) {
+    Lexer lexer(list);
+    size_t element_count = 0;
+    while (true) {
+        Token token = lexer.Next();
+        if (token.kind == TokenKind::kEnd) {  // missing element; report the list terminator
+            const std::string_view terminator(list.data() + list.size(), 1);
+            const TokenKind terminator_kind =
+                    (terminator[0] == ',') ? TokenKind::kComma : TokenKind::kCloseBracket;
+            *error_token = Token{terminator_kind, terminator};
+            return false;
         }
-        case ExpressionType::kFloat: {
-            ParseFloatVector(vector_string, &error_flag);
-            break;
+        if ((token.kind != TokenKind::kWord) || (element_count == capacity) ||
+            !ParseNumber(token.text, out + element_count)) {
+            *error_token = token;
+            return false;
         }
-        case ExpressionType::kDouble: {
-            ParseDoubleVector(vector_string, &error_flag);
-            break;
+        ++element_count;
+        token = lexer.Next();
+        if (token.kind == TokenKind::kEnd) break;
+        if (token.kind != TokenKind::kComma) {
+            *error_token = token;
+            return false;
         }
-        case ExpressionType::kBool: {
-            ParseBoolVector(vector_string, &error_flag);
-            break;
+    }
+    *count = element_count;
+    return true;
+}
+
+// Splits a comma-separated list into up to chunk_count chunks of similar size at comma
+// boundaries, excluding the commas themselves
+void SplitAtCommas(std::string_view list,
+                   size_t chunk_count,
+                   std::pmr::vector<std::string_view>* chunks) {
+    size_t chunk_start = 0;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        const size_t target = std::max(chunk_start, i * list.size() / chunk_count);
+        const size_t comma = list.find(',', target);
+        if (comma == std::string_view::npos) break;
+        chunks->push_back(list.substr(chunk_start, comma - chunk_start));
+        chunk_start = comma + 1;
+    }
+    chunks->push_back(list.substr(chunk_start));
+}
+
+// Parses the elements of a numeric vector (the text between its brackets) directly into a
+// pre-sized contiguous buffer. Large vectors are split at commas and parsed on up to thread_count
+// threads.
+template <typename T>
+bool ParseNumericElements(std::string_view elements,
+                          size_t thread_count,
+                          std::pmr::memory_resource* scratch,
+                          std::pmr::vector<T>* values,
+                          Token* error_token) {
+    values->clear();
+    if (elements.find_first_not_of(" \t\n\v\f\r") == std::string_view::npos) return true;
+    const size_t chunk_count =
+            std::clamp<size_t>(elements.size() / kMinBytesPerParallelChunk, 1, thread_count);
+    std::pmr::vector<std::string_view> chunks(scratch);
+    SplitAtCommas(elements, chunk_count, &chunks);
+    // Size the output from per-chunk upper bounds, so each chunk can be written in place
+    std::pmr::vector<size_t> offsets(chunks.size() + 1, 0, scratch);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        offsets[i + 1] = offsets[i] + MaxElementCount(chunks[i]);
+    }
+    values->resize(offsets.back());
+    std::pmr::vector<size_t> counts(chunks.size(), 0, scratch);
+    std::pmr::vector<Token> error_tokens(chunks.size(), scratch);
+    std::pmr::vector<char> succeeded(chunks.size(), false, scratch);
+    auto parse_chunk = [&](size_t i) {
+        succeeded[i] = ParseNumericList(chunks[i],
+                                        values->data() + offsets[i],
+                                        offsets[i + 1] - offsets[i],
+                                        &counts[i],
+                                        &error_tokens[i]);
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); ++i) threads.emplace_back(parse_chunk, i);
+    parse_chunk(0);
+    for (std::thread& thread : threads) thread.join();
+    // Report the first error in source order, and otherwise close any gaps between chunks
+    size_t element_count = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (!succeeded[i]) {
+            *error_token = error_tokens[i];
+            return false;
         }
+        std::copy_n(values->begin() + offsets[i], counts[i], values->begin() + element_count);
+        element_count += counts[i];
+    }
+    values->resize(element_count);
+    return true;
+}
+
+// Parses a numeric vector given its opening '[' token. Vectors without comments or strings take
+// the bulk path, which scans the input for the closing ']' directly (on up to thread_count threads
+// if large); others are read token by token. On failure, returns false with *token set to the
+// token that could not be parsed.
+template <typename T>
+bool ParseNumericVector(Lexer* lexer,
+                        T parse_element(std::string_view, bool*),
+                        size_t thread_count,
+                        std::pmr::memory_resource* scratch,
+                        ValueStore* values,
+                        size_t* slot,
+                        Token* token) {
+    const std::string_view input = lexer->Input();
+    const size_t elements_start = static_cast<size_t>(token->text.data() - input.data()) + 1;
+    const size_t elements_end = input.find(']', elements_start);
+    const std::string_view elements = input.substr(elements_start, elements_end - elements_start);
+    if ((elements_end == std::string_view::npos) ||
+        (elements.find(Lexer::kCommentChar) != std::string_view::npos) ||
+        (elements.find(Lexer::kQuoteChar) != std::string_view::npos)) {
+        return ParseVectorElements<T>(
+                lexer, TokenKind::kWord, parse_element, scratch, values, slot, token);
     }
-    return !error_flag;  // return true if can parse successfully, false otherwise
+    // Parsed in place in the store's memory, so that storing it moves rather than copies
+    Stored<std::vector<T>> parsed_values(values->Resource());
+    if (!ParseNumericElements(elements, thread_count, scratch, &parsed_values, token)) {
+        return false;
+    }
+    lexer->Seek(elements_end + 1);
+    *slot = values->Add<std::vector<T>>(std::move(parsed_values));
+    return true;
+}
+
+// Parses a vector given its opening '[' token, appending the parsed vector to values. Large numeric
+// vectors are parsed on up to thread_count threads. On failure, returns false with *token set to
+// the token that could not be parsed.
+bool ParseVector(Lexer* lexer,
+                 ExpressionType type,
+                 size_t thread_count,
+                 std::pmr::memory_resource* scratch,
+                 ValueStore* values,
+                 size_t* slot,
+                 Token* token) {
+    switch (type) {
+        case ExpressionType::kString:
+            return ParseVectorElements<std::string>(
+                    lexer, TokenKind::kString, ParseString, scratch, values, slot, token);
+        case ExpressionType::kInt:
+            return ParseNumericVector(
+                    lexer, ParseInt, thread_count, scratch, values, slot, token);
+        case ExpressionType::kUint:
+            return ParseNumericVector(
+                    lexer, ParseUint, thread_count, scratch, values, slot, token);
+        case ExpressionType::kFloat:
+            return ParseNumericVector(
+                    lexer, ParseFloat, thread_count, scratch, values, slot, token);
+        case ExpressionType::kDouble:
+            return ParseNumericVector(
+                    lexer, ParseDouble, thread_count, scratch, values, slot, token);
+        case ExpressionType::kBool:
+            return ParseVectorElements<bool>(
+                    lexer, TokenKind::kWord, ParseBool, scratch, values, slot, token);
+    }
+    return false;
 }
 
-bool CheckParseExpression(const std::string& expression_string,
-                          const std::string& type_string,
-                          bool is_vector) {
-    return is_vector ? CheckParseVector(expression_string, type_string)
-                     : CheckParseValue(expression_string, type_string);
+// Writes a parsed value in config syntax, for debug printing
+template <typename T>
+void PrintValue(std::ostream& os, const T& value) {
+    os << value;
 }
 
-}  // namespace
+void PrintValue(std::ostream& os, const std::pmr::string& value) {
+    os << '"' << value << '"';
+}
 
-ConfigParser::ConfigParser(const std::string& config_path)
-    : _config_path(config_path), _line_number{0} {
-    // Open config file
-    std::ifstream input_filestream(config_path);
-    if (!input_filestream.is_open()) {
-        _error_messages.emplace_back("Error opening file: " + config_path);
-        return;
+template <typename T>
+void PrintValue(std::ostream& os, const std::pmr::vector<T>& values) {
+    os << "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        PrintValue(os, values[i]);
+        if (i + 1 < values.size()) os << ", ";
     }
-    const std::vector<std::string> declarations = PreprocessInput(input_filestream);
-    for (const std::string& line : declarations) {
-        ++_line_number;
-        size_t current_index = 0;
-        std::string type_string, name_string, equals_string, expression_string;
-        bool is_vector;
-        // Read type
-        type_string = ReadNextToken(line, &current_index, ConfigParser::is_space);
-        is_vector =
-                (type_string.size() >= 2) && (type_string.substr(type_string.size() - 2) == "[]");
-        if (is_vector) {
-            type_string.erase(type_string.size() - 2);  // remove [] from type_string
-        }
-        //        std::cout << "type_string: " << type_string << std::endl;
-        if (!TypeStringIsValid(type_string)) {
-            AddErrorMessage("invalid type: " + type_string);
-            return;
-        }
-        SkipWhitespace(line, &current_index);
-        // Read name
-        name_string = ReadNextToken(line, &current_index, ConfigParser::is_space);
-        //        std::cout << "name_string: " << name_string << std::endl;
-        if (_var_map.count(name_string)) {
-            AddErrorMessage("redefinition of entity: " + name_string);
-            return;
-        }
-        SkipWhitespace(line, &current_index);
-        // Verify equals sign is next
-        equals_string = ReadNextToken(line, &current_index, ConfigParser::is_space);
-        //        std::cout << "equals_string: " << equals_string << std::endl;
-        if (equals_string != "=") {
-            AddErrorMessage("expected \"=\", encountered \"" + equals_string + "\"");
-            return;
-        }
-        SkipWhitespace(line, &current_index);
-        // If type is vector, look for enclosing []
-        if (is_vector) {
-            if ((line[current_index] != '[') || (line.back() != ']')) {
-                AddErrorMessage("vector must be enclosed in []");
+    os << "]";
+}
+
+template <typename T>
+void PrintSlot(std::ostream& os, const ValueStore& values, size_t slot) {
+    PrintValue(os, values.Slots<T>()[slot]);
+}
+
+// Positions of a config's variables by the hash of their declaration's text, for Reparse. Open
+// addressing over a flat array, since the hashes are already uniformly distributed. The first
+// position inserted with a given hash is kept.
+class DeclarationTable {
+  public:
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    void Reserve(size_t count) {
+        _entries.assign(std::bit_ceil(std::max<size_t>(2 * count, 16)), Entry{0, 0});
+        _mask = _entries.size() - 1;
+    }
+    // Reserve must have been called with at least the number of positions inserted
+    void Insert(uint64_t hash, size_t position) {
+        for (size_t i = hash & _mask;; i = (i + 1) & _mask) {
+            if (_entries[i].position_plus_one == 0) {
+                _entries[i] = Entry{hash, static_cast<uint32_t>(position + 1)};
                 return;
             }
-            expression_string = line.substr(current_index);
-            current_index = line.size();
+            if (_entries[i].hash == hash) return;
         }
-        // If type is string, look for enclosing ""
-        else if (type_string == kStringTypeString) {
-            if ((line[current_index] != '"') || (line.back() != '"')) {
-                AddErrorMessage("string value must be enclosed in \"\"");
-                return;
-            }
-            expression_string = line.substr(current_index);
-            current_index = line.size();
-        } else {  // single non-string value
-            expression_string = ReadNextToken(line, &current_index, ConfigParser::is_space);
+    }
+    size_t Find(uint64_t hash) const {
+        if (_entries.empty()) return kNotFound;
+        for (size_t i = hash & _mask;; i = (i + 1) & _mask) {
+            if (_entries[i].position_plus_one == 0) return kNotFound;
+            if (_entries[i].hash == hash) return _entries[i].position_plus_one - 1;
         }
-        //        std::cout << "value_string: " << value_string << std::endl << std::endl;
-        // Check if the value string is valid for the given type
-        if (!CheckParseExpression(expression_string, type_string, is_vector)) {
-            AddErrorMessage(std::string("could not parse `") + expression_string + "` as type " +
-                            type_string + (is_vector ? "[]" : ""));
-            return;
+    }
+
+  private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t position_plus_one;  // 0 for an empty entry
+    };
+
+    std::vector<Entry> _entries;
+    size_t _mask = 0;
+};
+
+}  // namespace
+
+class ConfigParser::LoadScope {
+  public:
+    // Creates the stats of config_parser if options enable them. The scope must end before
+    // config_parser is moved.
+    LoadScope(ConfigParser* config_parser, const ParseOptions& options)
+        : _config_parser{config_parser}, _profile_access{options.profile_access} {
+        if (!options.collect_stats) return;
+        config_parser->_stats = std::make_unique<ParseStats>(options.slowest_declaration_count);
+        _start = std::chrono::steady_clock::now();
+        _start_allocation_count = AllocationCount();
+    }
+    ~LoadScope() {
+        if (ParseStats* stats = _config_parser->_stats.get()) {
+            stats->total_nanoseconds = NanosecondsSince(_start);
+            stats->allocations_counted = CountsAllocations();
+            stats->allocation_count = AllocationCount() - _start_allocation_count;
+            stats->SortSlowestDeclarations();
         }
-        // We should now be at the end of the declaration
-        if (current_index < line.size()) {
-            AddErrorMessage(std::string("expected ") + kDeclarationTerminationChar + " at \"" +
-                            line.substr(current_index) + "\"");
-            return;
+        if (_profile_access) {
+            _config_parser->_access_profile =
+                    std::make_unique<AccessProfile>(_config_parser->_var_map);
         }
-        _var_map[name_string] = Variable{type_string, is_vector, expression_string};
     }
-}
 
-std::string ConfigParser::GetString(const std::string& variable_name) {
-    static const std::string expected_type_string = kStringTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+  private:
+    ConfigParser* _config_parser;
+    bool _profile_access;
+    std::chrono::steady_clock::time_point _start;
+    uint64_t _start_allocation_count = 0;
+};
+
+ConfigParser::ConfigParser(const std::string& config_path, const ParseOptions& options)
+    : _arena(std::make_unique<ConfigArena>(options.memory_resource)),
+      _config_path(config_path),
+      _options(FileOptions(config_path, options)) {
+    const LoadScope load_scope(this, options);
+    if (options.use_binary_cache) {
+        LoadWithBinaryCache(options);
+        return;
+    }
+    std::string contents;
+    bool read = false;
+    {
+        const PhaseTimer read_timer(_stats ? &_stats->read_nanoseconds : nullptr);
+        read = ReadFile(config_path, &contents);
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseString(expression_string, &error_flag_unusued);
+    if (!read) {
+        AddError(ConfigError{ErrorCode::kOpenFile}, std::string_view());
+        return;
+    }
+    if (options.lazy) {
+        // Keep a copy rather than a mapping, since the file may be rewritten while it is in use
+        ParseLazily(std::make_unique<LazyValues>(std::move(contents)));
+        return;
+    }
+    Parse(contents, options.thread_count);
 }
 
-int ConfigParser::GetInt(const std::string& variable_name) {
-    static const std::string expected_type_string = kIntTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+ConfigParser& ConfigParser::operator=(ConfigParser&& other) noexcept {
+    // Containers allocating from an arena do not take the arena along when assigned, so the values
+    // of other could not be moved here without copying them into this config's arena
+    if (this != &other) {
+        std::destroy_at(this);
+        std::construct_at(this, std::move(other));
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseInt(expression_string, &error_flag_unusued);
+    return *this;
 }
 
-size_t ConfigParser::GetUint(const std::string& variable_name) {
-    static const std::string expected_type_string = kUintTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+ConfigParser ConfigParser::FromBuffer(std::string_view contents,
+                                      const std::string& source_name,
+                                      const ParseOptions& options) {
+    ConfigParser config_parser(std::make_unique<ConfigArena>(options.memory_resource));
+    config_parser._config_path = source_name;
+    config_parser._options = options;
+    {
+        // Ends before the return, which may move config_parser
+        const LoadScope load_scope(&config_parser, options);
+        if (options.lazy) {
+            config_parser.ParseLazily(std::make_unique<LazyValues>(std::string(contents)));
+        } else {
+            config_parser.Parse(contents, options.thread_count);
+        }
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseUint(expression_string, &error_flag_unusued);
+    return config_parser;
 }
 
-float ConfigParser::GetFloat(const std::string& variable_name) {
-    static const std::string expected_type_string = kFloatTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
-    }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseFloat(expression_string, &error_flag_unusued);
+ConfigParser ConfigParser::FromBuffer(const char* data,
+                                      size_t size,
+                                      const std::string& source_name,
+                                      const ParseOptions& options) {
+    return FromBuffer(std::string_view(data, size), source_name, options);
 }
 
-double ConfigParser::GetDouble(const std::string& variable_name) {
-    static const std::string expected_type_string = kDoubleTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+ConfigParser ConfigParser::FromMappedFile(const std::string& config_path,
+                                          const ParseOptions& options) {
+    ConfigParser config_parser(std::make_unique<ConfigArena>(options.memory_resource));
+    config_parser._config_path = config_path;
+    config_parser._options = FileOptions(config_path, options);
+    {
+        // Ends before the return, which may move config_parser
+        const LoadScope load_scope(&config_parser, options);
+        std::unique_ptr<MappedFile> mapped_file;
+        {
+            ParseStats* stats = config_parser._stats.get();
+            const PhaseTimer read_timer(stats ? &stats->read_nanoseconds : nullptr);
+            mapped_file = std::make_unique<MappedFile>(config_path);
+        }
+        if (!mapped_file->IsOpen()) {
+            config_parser.AddError(ConfigError{ErrorCode::kOpenFile}, std::string_view());
+        } else if (options.lazy) {
+            config_parser.ParseLazily(std::make_unique<LazyValues>(std::move(mapped_file)));
+        } else {
+            config_parser.Parse(mapped_file->Contents(), options.thread_count);
+        }
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseDouble(expression_string, &error_flag_unusued);
+    return config_parser;
 }
 
-bool ConfigParser::GetBool(const std::string& variable_name) {
-    static const std::string expected_type_string = kBoolTypeString;
-    static const bool expected_is_vector = false;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+ConfigParser ConfigParser::Reparse(const ConfigParser& previous,
+                                   std::string_view contents,
+                                   ConfigChanges* changes) {
+    if (changes != nullptr) *changes = ConfigChanges();
+    ParseOptions options = previous._options;
+    options.use_binary_cache = false;
+    options.lazy = false;
+    options.reparsable = true;
+    ConfigParser config_parser(std::make_unique<ConfigArena>(previous._arena->Upstream()));
+    config_parser._config_path = previous._config_path;
+    config_parser._options = options;
+    config_parser._include_chain = previous._include_chain;
+    std::vector<char> reused;
+    bool reparsed = false;
+    {
+        // Ends before the returns, which may move config_parser
+        const LoadScope load_scope(&config_parser, options);
+        ParseStats* stats = config_parser._stats.get();
+        if (stats) stats->bytes += contents.size();
+        const PhaseTimer parse_timer(stats ? &stats->parse_nanoseconds : nullptr);
+        reparsed = config_parser.ReparseDeclarations(previous, contents, &reused);
+    }
+    if (!reparsed) {
+        // Start over with a full parse, so that the errors reported are the same
+        ConfigParser full_parser(std::make_unique<ConfigArena>(previous._arena->Upstream()));
+        full_parser._config_path = previous._config_path;
+        full_parser._options = options;
+        full_parser._include_chain = previous._include_chain;
+        {
+            const LoadScope load_scope(&full_parser, options);
+            full_parser.Parse(contents, options.thread_count);
+        }
+        return full_parser;
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseBool(expression_string, &error_flag_unusued);
+    if (changes != nullptr) config_parser.FindChanges(previous, reused, changes);
+    return config_parser;
 }
 
-std::vector<std::string> ConfigParser::GetStringVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kStringTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
-    }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseStringVector(expression_string, &error_flag_unusued);
+template <typename T>
+LookupResult<T> ConfigParser::Lookup(std::string_view variable_name) const {
+    const AccessProfile::Scope access(_access_profile.get(), Getter::kLookup,
+                                      ConfigTypeTraits<T>::kVariableType, _var_map, variable_name);
+    return FindValue<T>(variable_name);
+}
+
+template <typename T>
+LookupResult<T> ConfigParser::FindValue(std::string_view variable_name) const {
+    const Variable* variable = nullptr;
+    const LookupError error =
+            MatchVariable(variable_name, ConfigTypeTraits<T>::kVariableType, &variable);
+    if (error != LookupError::kNone) return LookupResult<T>(error, variable_name, variable);
+    return LookupResult<T>(ViewSlot<T>(variable->source, variable->slot));
 }
 
-std::vector<int> ConfigParser::GetIntVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kIntTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+template LookupResult<std::string> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<int> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<size_t> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<float> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<double> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<bool> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<std::string>> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<int>> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<size_t>> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<float>> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<double>> ConfigParser::Lookup(std::string_view) const;
+template LookupResult<std::vector<bool>> ConfigParser::Lookup(std::string_view) const;
+
+template <typename T>
+ValueHandle<T> ConfigParser::Resolve(const std::string& variable_name) const {
+    const AccessProfile::Scope access(_access_profile.get(), Getter::kResolve,
+                                      ConfigTypeTraits<T>::kVariableType, _var_map, variable_name);
+    const Variable* variable = nullptr;
+    const LookupError error =
+            MatchVariable(variable_name, ConfigTypeTraits<T>::kVariableType, &variable);
+    if (error != LookupError::kNone) {
+        CheckedLookup<T>(variable_name);  // records the error
+        return ValueHandle<T>();
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseIntVector(expression_string, &error_flag_unusued);
+    return ValueHandle<T>(*variable);
 }
 
-std::vector<size_t> ConfigParser::GetUintVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kUintTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+template ValueHandle<std::string> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<int> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<size_t> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<float> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<double> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<bool> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<std::string>> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<int>> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<size_t>> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<float>> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<double>> ConfigParser::Resolve(const std::string&) const;
+template ValueHandle<std::vector<bool>> ConfigParser::Resolve(const std::string&) const;
+
+uint64_t ConfigParser::SchemaId() const {
+    // Order-independent combination of per-variable hashes, since handles do not depend on the
+    // relative order of declarations of different types
+    uint64_t schema_id = _var_map.Size();
+    for (const auto& [name, variable] : _var_map) {
+        uint64_t hash = std::hash<std::string_view>{}(name);
+        hash ^= (static_cast<uint64_t>(variable.type.type) << 1) | variable.type.is_vector;
+        hash *= 0x9e3779b97f4a7c15ULL;
+        hash ^= ((uint64_t{variable.source} << 32) | variable.slot) + (hash >> 29);
+        schema_id += hash * 0xbf58476d1ce4e5b9ULL;
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseUintVector(expression_string, &error_flag_unusued);
+    return schema_id;
 }
 
-std::vector<float> ConfigParser::GetFloatVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kFloatTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+bool ConfigParser::ValidateAll() const {
+    if (!_lazy_values) return true;
+    bool all_valid = true;
+    for (const auto& [name, variable] : _var_map) {
+        if (!ParseLazyValue(variable)) all_valid = false;
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseFloatVector(expression_string, &error_flag_unusued);
+    return all_valid;
 }
 
-std::vector<double> ConfigParser::GetDoubleVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kDoubleTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+template <typename T>
+LookupResult<T> ConfigParser::CheckedLookup(const std::string& variable_name) const {
+    const LookupResult<T> result = FindValue<T>(variable_name);
+    if (!result) {
+        ConfigError error{ErrorCode::kLookupNotFound, ConfigTypeTraits<T>::kVariableType};
+        if (result.error() == LookupError::kWrongType) {
+            error.code = ErrorCode::kLookupWrongType;
+            error.found_type = _var_map.Find(variable_name)->type;
+        } else if (result.error() == LookupError::kInvalidValue) {
+            error.code = ErrorCode::kLookupInvalidValue;
+        }
+        AddError(error, variable_name);
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseDoubleVector(expression_string, &error_flag_unusued);
+    return result;
 }
 
-std::vector<bool> ConfigParser::GetBoolVector(const std::string& variable_name) {
-    static const std::string expected_type_string = kBoolTypeString;
-    static const bool expected_is_vector = true;
-    if (!CheckVariableExists(variable_name, expected_type_string, expected_is_vector)) {
-        return {};
+// Returns a copy of the stored value, or a default-constructed value if the variable is not found
+template <typename T>
+T ConfigParser::GetValue(const std::string& variable_name) const {
+    const LookupResult<T> result = CheckedLookup<T>(variable_name);
+    if (!result) return T();
+    if constexpr (std::is_same_v<T, std::vector<bool>>) {
+        return T(result.value()->begin(), result.value()->end());
+    } else if constexpr (ConfigTypeTraits<T>::kIsVector) {
+        return T(result.value().begin(), result.value().end());
+    } else {
+        return T(result.value());
     }
-    const std::string expression_string = _var_map[variable_name].expression_string;
-    bool error_flag_unusued;  // parse check already done
-    return ParseBoolVector(expression_string, &error_flag_unusued);
+}
+
+std::string ConfigParser::GetString(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetString, variable_name);
+    return GetValue<std::string>(variable_name);
+}
+
+int ConfigParser::GetInt(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetInt, variable_name);
+    return GetValue<int>(variable_name);
+}
+
+size_t ConfigParser::GetUint(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetUint, variable_name);
+    return GetValue<size_t>(variable_name);
+}
+
+float ConfigParser::GetFloat(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetFloat, variable_name);
+    return GetValue<float>(variable_name);
+}
+
+double ConfigParser::GetDouble(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetDouble, variable_name);
+    return GetValue<double>(variable_name);
+}
+
+bool ConfigParser::GetBool(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetBool, variable_name);
+    return GetValue<bool>(variable_name);
+}
+
+std::vector<std::string> ConfigParser::GetStringVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetStringVector, variable_name);
+    return GetValue<std::vector<std::string>>(variable_name);
+}
+
+std::vector<int> ConfigParser::GetIntVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetIntVector, variable_name);
+    return GetValue<std::vector<int>>(variable_name);
+}
+
+std::vector<size_t> ConfigParser::GetUintVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetUintVector, variable_name);
+    return GetValue<std::vector<size_t>>(variable_name);
+}
+
+std::vector<float> ConfigParser::GetFloatVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetFloatVector, variable_name);
+    return GetValue<std::vector<float>>(variable_name);
+}
+
+std::vector<double> ConfigParser::GetDoubleVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetDoubleVector, variable_name);
+    return GetValue<std::vector<double>>(variable_name);
+}
+
+std::vector<bool> ConfigParser::GetBoolVector(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetBoolVector, variable_name);
+    return GetValue<std::vector<bool>>(variable_name);
+}
+
+std::string_view ConfigParser::GetStringView(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetStringView, variable_name);
+    return CheckedLookup<std::string>(variable_name).value();
+}
+
+std::span<const std::pmr::string> ConfigParser::GetStringSpan(
+        const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetStringSpan, variable_name);
+    return CheckedLookup<std::vector<std::string>>(variable_name).value();
+}
+
+std::span<const int> ConfigParser::GetIntSpan(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetIntSpan, variable_name);
+    return CheckedLookup<std::vector<int>>(variable_name).value();
+}
+
+std::span<const size_t> ConfigParser::GetUintSpan(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetUintSpan, variable_name);
+    return CheckedLookup<std::vector<size_t>>(variable_name).value();
+}
+
+std::span<const float> ConfigParser::GetFloatSpan(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetFloatSpan, variable_name);
+    return CheckedLookup<std::vector<float>>(variable_name).value();
+}
+
+std::span<const double> ConfigParser::GetDoubleSpan(const std::string& variable_name) const {
+    const AccessProfile::Scope access = ProfileAccess(Getter::kGetDoubleSpan, variable_name);
+    return CheckedLookup<std::vector<double>>(variable_name).value();
+}
+
+AccessReport ConfigParser::ReportAccesses(size_t hottest_key_count) const {
+    if (!_access_profile) return AccessReport();
+    return _access_profile->Report(_var_map, hottest_key_count);
 }
 
 size_t ConfigParser::ErrorCount() const {
-    return _error_messages.size();
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    return _errors.size();
 }
 
 std::string ConfigParser::ErrorString() const {
-    return _error_messages.size() ? _error_messages[0] : std::string("");
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    if (_errors.empty()) return std::string("");
+    return FormatConfigError(_errors[0], ErrorText(_errors[0]), _config_path);
+}
+
+std::vector<std::string> ConfigParser::ErrorStrings() const {
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    std::vector<std::string> error_strings;
+    error_strings.reserve(_errors.size());
+    for (const ConfigError& error : _errors) {
+        error_strings.push_back(FormatConfigError(error, ErrorText(error), _config_path));
+    }
+    return error_strings;
+}
+
+std::vector<ConfigError> ConfigParser::Errors() const {
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    return _errors;
+}
+
+std::string ConfigParser::FormatError(const ConfigError& error) const {
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    return FormatConfigError(error, ErrorText(error), _config_path);
 }
 
 void ConfigParser::PrintVariableMap() const {
     std::cout << "Variable Map:" << std::endl;
-    for (const auto& item : _var_map) {
-        std::string variable_name = item.first;
-        std::string type_string = item.second.type_string + (item.second.is_vector ? "[]" : "");
-        std::string expression_string = item.second.expression_string;
-        std::cout << "\t" << variable_name << " --> <" << type_string << "> : " << expression_string
-                  << std::endl;
+    for (const auto& [variable_name, variable] : _var_map) {
+        if (_lazy_values) ParseLazyValue(variable);
+        const bool is_vector = variable.type.is_vector;
+        const ValueStore& values = Values(variable.source);
+        std::ostringstream value_stream;
+        value_stream << std::boolalpha;
+        switch (variable.type.type) {
+            case ExpressionType::kString:
+                is_vector
+                        ? PrintSlot<std::vector<std::string>>(value_stream, values, variable.slot)
+                        : PrintSlot<std::string>(value_stream, values, variable.slot);
+                break;
+            case ExpressionType::kInt:
+                is_vector
+                        ? PrintSlot<std::vector<int>>(value_stream, values, variable.slot)
+                        : PrintSlot<int>(value_stream, values, variable.slot);
+                break;
+            case ExpressionType::kUint:
+                is_vector
+                        ? PrintSlot<std::vector<size_t>>(value_stream, values, variable.slot)
+                        : PrintSlot<size_t>(value_stream, values, variable.slot);
+                break;
+            case ExpressionType::kFloat:
+                is_vector
+                        ? PrintSlot<std::vector<float>>(value_stream, values, variable.slot)
+                        : PrintSlot<float>(value_stream, values, variable.slot);
+                break;
+            case ExpressionType::kDouble:
+                is_vector
+                        ? PrintSlot<std::vector<double>>(value_stream, values, variable.slot)
+                        : PrintSlot<double>(value_stream, values, variable.slot);
+                break;
+            case ExpressionType::kBool:
+                is_vector
+                        ? PrintSlot<std::vector<bool>>(value_stream, values, variable.slot)
+                        : PrintSlot<bool>(value_stream, values, variable.slot);
+                break;
+        }
+        std::cout << "\t" << variable_name << " --> <" << variable.type.ToString() << "> : "
+                  << value_stream.str() << std::endl;
     }
 }
 
 /** End of public API **/
 
+std::string FormatLookupError(LookupError error,
+                              std::string_view variable_name,
+                              VariableType expected_type,
+                              const Variable* found_variable) {
+    switch (error) {
+        case LookupError::kNone:
+            break;
+        case LookupError::kNotFound:
+            return "Error: didn't find variable " + std::string(variable_name) + " of type " +
+                   expected_type.ToString();
+        case LookupError::kWrongType:
+            return "Error: variable " + std::string(variable_name) + " has type " +
+                   found_variable->type.ToString() + ", not " + expected_type.ToString();
+        case LookupError::kInvalidValue:
+            return "Error: variable " + std::string(variable_name) + " of type " +
+                   expected_type.ToString() + " has an invalid value";
+    }
+    return std::string();
+}
+
 /** Helper Methods **/
 
 bool ConfigParser::TypeStringIsValid(const std::string& type_string) {
-    return std::find(kValidTypeStrings.begin(), kValidTypeStrings.end(), type_string) !=
-           kValidTypeStrings.end();
+    ExpressionType type;
+    return ParseTypeString(type_string, &type);
 }
 
 bool ConfigParser::is_space(char c) {
     return (std::isspace(static_cast<unsigned char>(c)));
 }
 
-// Checks if a variable of the given type exists, and adds an error message if not found
-bool ConfigParser::CheckVariableExists(const std::string& variable_name,
-                                       const std::string& expected_type_string,
-                                       bool expected_is_vector) {
-    const std::string error_message = std::string("Error: didn't find variable ") + variable_name +
-                                      " of type " + expected_type_string +
-                                      (expected_is_vector ? "[]" : "");
-    bool variable_exists = (_var_map.count(variable_name) != 0) &&
-                           (_var_map.at(variable_name).type_string == expected_type_string) &&
-                           (_var_map.at(variable_name).is_vector == expected_is_vector);
-    if (!variable_exists) {
-        _error_messages.emplace_back(std::move(error_message));
+// Looks up a variable of the given type without side effects. On success, sets *variable to the
+// variable; otherwise, sets it to the variable with that name if one exists, or to nullptr.
+LookupError ConfigParser::MatchVariable(std::string_view variable_name,
+                                        VariableType expected_type,
+                                        const Variable** variable) const {
+    *variable = _var_map.Find(variable_name);
+    if (*variable == nullptr) return LookupError::kNotFound;
+    if ((*variable)->type != expected_type) return LookupError::kWrongType;
+    if (_lazy_values && !ParseLazyValue(**variable)) {
+        return LookupError::kInvalidValue;
+    }
+    return LookupError::kNone;
+}
+
+// Loads from the binary cache if it is valid for the current file contents, and otherwise parses
+// the file and rewrites the cache. Failing to write the cache is not an error.
+void ConfigParser::LoadWithBinaryCache(const ParseOptions& options) {
+    const MappedFile mapped_file(_config_path);
+    if (!mapped_file.IsOpen()) {
+        AddError(ConfigError{ErrorCode::kOpenFile}, std::string_view());
+        return;
+    }
+    const std::string cache_path = _config_path + kBinaryCacheSuffix;
+    const MappedFile mapped_cache(cache_path);
+    if (mapped_cache.IsOpen() &&
+        ReadBinaryCache(mapped_cache.Contents(), mapped_file.Contents(), &_var_map, &_values)) {
+        return;
+    }
+    // Discard anything loaded from a stale or malformed cache
+    _var_map.Clear();
+    _values = ValueStore(_arena.get());
+    Parse(mapped_file.Contents(), options.thread_count);
+    // The cache is keyed by the contents of this file alone, so it cannot hold included values
+    if (_errors.empty() && _included_files.empty()) {
+        WriteBinaryCache(cache_path, mapped_file.Contents(), _var_map, _values);
+    }
+}
+
+// Indexes the declarations of the source held by lazy_values, leaving their values to be parsed on
+// first access by ParseLazyValue. Handles invalid declarations like ParseRange.
+void ConfigParser::ParseLazily(std::unique_ptr<LazyValues> lazy_values) {
+    _lazy_values = std::move(lazy_values);
+    const std::string_view source = _lazy_values->source;
+    if (_stats) _stats->bytes += source.size();
+    const PhaseTimer parse_timer(_stats ? &_stats->parse_nanoseconds : nullptr);
+    ParseRange(source, 0, source.size(), SourceLocation{0, 1, 1});
+}
+
+// Parses the value of a variable on its first access in lazy mode, returning whether it is valid.
+// On failure the slot keeps its default value and an error message is added.
+bool ConfigParser::ParseLazyValue(const Variable& variable) const {
+    if (variable.source != 0) return true;  // included configs are parsed at load time
+    const VariableType type = variable.type;
+    const size_t slot = variable.slot;
+    const size_t array_index = ValueStore::SlotArrayIndex(type);
+    std::deque<LazyValues::Value>& lazy_values = _lazy_values->values[array_index];
+    if (slot >= lazy_values.size()) return true;  // parsed at load time
+    LazyValues::Value& lazy_value = lazy_values[slot];
+    std::call_once(lazy_value.parsed, [&] {
+        Lexer lexer(_lazy_values->source);
+        lexer.Seek(lazy_value.begin);
+        std::pmr::monotonic_buffer_resource scratch(_arena->Upstream());
+        ValueStore values(_values.Resource());  // so that moving the value does not copy it
+        size_t value_slot = 0;
+        const Token key{TokenKind::kWord, lazy_value.key};
+        lazy_value.valid =
+                ParseExpression(&lexer, type, key, &scratch, &values, &value_slot);
+        if (lazy_value.valid) _values.MoveValue(array_index, &values, value_slot, slot);
+    });
+    return lazy_value.valid;
+}
+
+// Parses all declarations in contents, handling errors like ParseRange. Large inputs are parsed
+// on up to thread_count threads (or one per hardware thread if thread_count is 0).
+void ConfigParser::Parse(std::string_view contents, size_t thread_count) {
+    thread_count = ResolveThreadCount(thread_count);
+    const size_t range_count = std::clamp<size_t>(
+            contents.size() / kMinBytesPerDeclarationRange, 1, thread_count);
+    if (_stats) _stats->bytes += contents.size();
+    if ((range_count > 1) && ParseRangesInParallel(contents, range_count)) return;
+    const PhaseTimer parse_timer(_stats ? &_stats->parse_nanoseconds : nullptr);
+    ParseRange(contents, 0, contents.size(), SourceLocation{0, 1, 1});
+}
+
+// Parses the declarations starting within [begin, end) of contents, where begin is the start of a
+// declaration (or of the input), and contents starts at origin in the source. Returns false if any
+// declaration is invalid: parsing stops there, or with ParseOptions::collect_all_errors resumes
+// after the invalid declaration's terminator.
+bool ConfigParser::ParseRange(std::string_view contents,
+                              size_t begin,
+                              size_t end,
+                              const SourceLocation& origin) {
+    Lexer lexer(contents, origin);
+    if (begin != 0) lexer.Seek(begin);
+    // Temporaries of value parsing, whose memory is reused from one declaration to the next. The
+    // pool takes its chunks from an arena of its own, released once the range is parsed.
+    ConfigArena scratch_arena(_arena->Upstream());
+    std::pmr::unsynchronized_pool_resource scratch(kScratchPoolOptions, &scratch_arena);
+    return ParseDeclarations(&lexer, end, &scratch);
+}
+
+// Parses the declarations from the lexer's position up to the first one starting at or after end
+// (an offset in the lexer's input), like ParseRange. With ParseOptions::reparsable, records the
+// hash of each declaration's text, from its first token to its terminator, for each variable it
+// adds. The hashes are only kept while they line up with _var_map, which a failed include directive
+// may have added variables to.
+bool ConfigParser::ParseDeclarations(Lexer* lexer,
+                                     size_t end,
+                                     std::pmr::memory_resource* scratch) {
+    const std::string_view contents = lexer->Input();
+    bool valid = true;
+    while (true) {
+        const Token token = lexer->Peek();
+        const size_t declaration_begin = static_cast<size_t>(token.text.data() - contents.data());
+        if ((token.kind == TokenKind::kEnd) || (declaration_begin >= end)) return valid;
+        const size_t variable_count = _var_map.Size();
+        if (ParseDeclaration(lexer, scratch)) {
+            if (_options.reparsable && (_declaration_hashes.size() == variable_count)) {
+                const uint64_t hash = HashContents(contents.substr(
+                        declaration_begin, lexer->ConsumedEnd() - declaration_begin));
+                _declaration_hashes.resize(_var_map.Size(), hash);
+            }
+            continue;
+        }
+        if (!_options.collect_all_errors) return false;
+        valid = false;
+        // Resynchronize after the declaration's terminator, unless the error was at or beyond it
+        const size_t terminator =
+                DeclarationScanner().FindTerminator(contents, declaration_begin, declaration_begin);
+        if (terminator == DeclarationScanner::kNotFound) return false;
+        const Token next = lexer->Peek();
+        if ((next.kind != TokenKind::kEnd) &&
+            (static_cast<size_t>(next.text.data() - contents.data()) <= terminator)) {
+            lexer->Seek(terminator + 1);
+        }
+    }
+}
+
+// Splits contents into up to range_count ranges of declarations, parses each on its own thread
+// into a separate ConfigParser, and merges the results in source order, offsetting each range's
+// value slots by the number of values of each type before it.
+// If any range has an error, or a variable is defined in more than one range, returns false with
+// nothing stored; the caller then parses sequentially, which reports the errors in source
+// order exactly as if the input had never been split.
+bool ConfigParser::ParseRangesInParallel(std::string_view contents, size_t range_count) {
+    std::vector<size_t> boundaries;
+    {
+        const PhaseTimer split_timer(_stats ? &_stats->split_nanoseconds : nullptr);
+        boundaries = FindDeclarationBoundaries(contents, range_count);
+    }
+    range_count = boundaries.size() - 1;
+    if (range_count < 2) return false;
+    std::vector<ConfigParser> range_parsers;
+    range_parsers.reserve(range_count);
+    for (size_t i = 0; i < range_count; ++i) {
+        // Sibling arenas, so that merging moves the values of each range rather than copying them
+        range_parsers.push_back(ConfigParser(_arena->NewSibling()));
+        range_parsers[i]._config_path = _config_path;  // for detecting include cycles
+        range_parsers[i]._include_chain = _include_chain;
+        range_parsers[i]._options.reparsable = _options.reparsable;
+        range_parsers[i]._options.include_directory = _options.include_directory;
+        if (_stats) {
+            range_parsers[i]._stats =
+                    std::make_unique<ParseStats>(_stats->slowest_declaration_limit);
+        }
+    }
+    std::vector<char> succeeded(range_count, false);
+    auto parse_range = [&](size_t i) {
+        succeeded[i] = range_parsers[i].ParseRange(contents, boundaries[i], boundaries[i + 1],
+                                                   SourceLocation{0, 1, 1});
+    };
+    {
+        const PhaseTimer parse_timer(_stats ? &_stats->parse_nanoseconds : nullptr);
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < range_count; ++i) threads.emplace_back(parse_range, i);
+        parse_range(0);
+        for (std::thread& thread : threads) thread.join();
+    }
+    if (std::find(succeeded.begin(), succeeded.end(), false) != succeeded.end()) return false;
+    // Merge in source order
+    const PhaseTimer merge_timer(_stats ? &_stats->merge_nanoseconds : nullptr);
+    size_t variable_count = 0;
+    for (const ConfigParser& range_parser : range_parsers) {
+        variable_count += range_parser._var_map.Size();
     }
-    return variable_exists;
+    _var_map.Reserve(variable_count);
+    for (ConfigParser& range_parser : range_parsers) {
+        const std::array<size_t, ValueStore::kSlotArrayCount> slot_offsets = _values.Sizes();
+        // Sources of the range's included values in this parser, skipping the variables of
+        // configs that an earlier range included too
+        std::vector<uint16_t> sources = {0};
+        std::vector<char> already_included = {false};
+        for (const std::shared_ptr<const ConfigParser>& included_parser :
+             range_parser._included_parsers) {
+            already_included.push_back(IsIncluded(included_parser));
+            sources.push_back(AddIncludedParser(included_parser));
+        }
+        for (const IncludedFile& included_file : range_parser._included_files) {
+            AddIncludedFile(included_file);
+        }
+        size_t range_index = 0;
+        for (const auto& [name, variable] : range_parser._var_map) {
+            const size_t index = range_index++;
+            if (already_included[variable.source]) continue;
+            Variable merged_variable = variable;
+            merged_variable.source = sources[variable.source];
+            if (variable.source == 0) {
+                merged_variable.slot += static_cast<uint32_t>(
+                        slot_offsets[ValueStore::SlotArrayIndex(variable.type)]);
+            }
+            if (!_var_map.Insert(name, merged_variable)) {  // redefinition
+                _var_map.Clear();
+                _values = ValueStore(_arena.get());
+                _declaration_hashes.clear();
+                _included_parsers.clear();
+                _included_files.clear();
+                return false;
+            }
+            if (_options.reparsable) {
+                _declaration_hashes.push_back(range_parser._declaration_hashes[index]);
+            }
+        }
+        _arena->Adopt(std::move(range_parser._arena));
+        _values.Append(std::move(range_parser._values));
+    }
+    // Only once every range has merged, since on failure the input is parsed again sequentially
+    if (_stats) {
+        for (const ConfigParser& range_parser : range_parsers) _stats->Merge(*range_parser._stats);
+    }
+    return true;
 }
 
-void ConfigParser::AddErrorMessage(const std::string& error_message) {
-    _error_messages.push_back("Parsing error in file " + _config_path + ", line " +
-                              std::to_string(_line_number) + ": " + error_message);
+// Parses contents for Reparse, recording the hash of each declaration's text. A declaration whose
+// hash was recorded by previous is not parsed; its value is copied from previous instead, and
+// (*reused)[i] is set for it, where i is its variable's index. Each run of adjacent declarations
+// that are new or changed is parsed as a range, all of them by one lexer and scratch pool. Returns
+// false on any error.
+bool ConfigParser::ReparseDeclarations(const ConfigParser& previous,
+                                       std::string_view contents,
+                                       std::vector<char>* reused) {
+    // Finds the position of the variable of previous declared by text with the given hash.
+    // Declarations mostly keep their order, so the few after the last match are tried first, and
+    // the table of all of them is only built if that fails. Included variables never match, so
+    // that include directives are always parsed again, picking up any change to included files.
+    const std::span<const uint64_t> previous_hashes =
+            (previous._declaration_hashes.size() == previous._var_map.Size())
+                    ? std::span<const uint64_t>(previous._declaration_hashes)
+                    : std::span<const uint64_t>();
+    const auto is_declared = [&](size_t position) {
+        return previous._var_map.At(position).second.source == 0;
+    };
+    size_t next_position = 0;  // just after the last match
+    DeclarationTable previous_positions;
+    bool table_built = false;
+    const auto find_previous = [&](uint64_t hash) {
+        const size_t window_end =
+                std::min(next_position + kReparseSearchWindow, previous_hashes.size());
+        for (size_t position = next_position; position < window_end; ++position) {
+            if ((previous_hashes[position] == hash) && is_declared(position)) return position;
+        }
+        if (!table_built) {
+            previous_positions.Reserve(previous_hashes.size());
+            for (size_t position = 0; position < previous_hashes.size(); ++position) {
+                if (is_declared(position)) {
+                    previous_positions.Insert(previous_hashes[position], position);
+                }
+            }
+            table_built = true;
+        }
+        return previous_positions.Find(hash);
+    };
+    _var_map.Reserve(previous._var_map.Size());
+    _declaration_hashes.reserve(previous._var_map.Size());
+    Lexer lexer(contents);
+    ConfigArena scratch_arena(_arena->Upstream());
+    std::pmr::unsynchronized_pool_resource scratch(kScratchPoolOptions, &scratch_arena);
+    // Start of the declarations not yet parsed or copied, and whether there are any
+    size_t run_begin = 0;
+    bool run_pending = false;
+    const auto parse_run = [&](size_t run_end) {
+        lexer.Seek(run_begin);
+        if (!ParseDeclarations(&lexer, run_end, &scratch)) return false;
+        reused->resize(_var_map.Size(), false);
+        return true;
+    };
+    DeclarationScanner scanner;
+    for (size_t begin = 0; begin < contents.size();) {
+        const size_t terminator = scanner.FindTerminator(contents, begin, begin);
+        const size_t end =
+                (terminator == DeclarationScanner::kNotFound) ? contents.size() : terminator + 1;
+        // Hashed from its first token, as ParseDeclarations does
+        const size_t first_token = SkipSpaceAndComments(contents, begin, end);
+        const uint64_t hash = HashContents(contents.substr(first_token, end - first_token));
+        const size_t position = find_previous(hash);
+        if (position != DeclarationTable::kNotFound) {
+            if (run_pending && !parse_run(first_token)) return false;
+            run_pending = false;
+            next_position = position + 1;
+            const auto [name, variable] = previous._var_map.At(position);
+            const size_t slot = _values.AddCopy(ValueStore::SlotArrayIndex(variable.type),
+                                                previous._values, variable.slot);
+            if (!_var_map.Insert(name, Variable{variable.type, 0, static_cast<uint32_t>(slot)})) {
+                return false;  // redefinition
+            }
+            _declaration_hashes.push_back(hash);
+            reused->push_back(true);
+            run_begin = end;
+        } else if (first_token != end) {
+            run_pending = true;
+        }
+        begin = end;
+    }
+    return !run_pending || parse_run(contents.size());
+}
+
+// Sets changes to the variables that differ between previous and this ConfigParser, where
+// reused[i] is set if the value of variable i was copied from previous (and so is unchanged)
+void ConfigParser::FindChanges(const ConfigParser& previous,
+                               const std::vector<char>& reused,
+                               ConfigChanges* changes) const {
+    size_t index = 0;
+    for (const auto& [name, variable] : _var_map) {
+        if (reused[index++]) continue;
+        const Variable* previous_variable = previous._var_map.Find(name);
+        if (previous_variable == nullptr) {
+            changes->added.emplace_back(name);
+            continue;
+        }
+        bool changed = (previous_variable->type != variable.type);
+        if (!changed && previous._lazy_values) {
+            changed = !previous.ParseLazyValue(*previous_variable);
+        }
+        if (!changed) {
+            const ValueStore& previous_values = previous.Values(previous_variable->source);
+            changed = !Values(variable.source)
+                               .ValueEquals(ValueStore::SlotArrayIndex(variable.type),
+                                            variable.slot, previous_values,
+                                            previous_variable->slot);
+        }
+        if (changed) changes->changed.emplace_back(name);
+    }
+    for (const auto& [name, variable] : previous._var_map) {
+        if (_var_map.Find(name) == nullptr) changes->removed.emplace_back(name);
+    }
+}
+
+// Parses a single declaration, up to and including its terminating semicolon, and stores its
+// value. Adds an error message and returns false if the declaration is invalid.
+bool ConfigParser::ParseDeclaration(Lexer* lexer, std::pmr::memory_resource* scratch) {
+    std::chrono::steady_clock::time_point start;
+    if (_stats) [[unlikely]] start = std::chrono::steady_clock::now();
+    Token token = lexer->Next();
+    if (token.kind == TokenKind::kSemicolon) return true;  // skip empty declaration
+    if ((token.kind == TokenKind::kWord) && (token.text == kIncludeKeyword)) {
+        return ParseInclude(lexer, token);
+    }
+    // Read type, with optional [] suffix
+    const std::string_view type_string = token.text;
+    ExpressionType type;
+    if ((token.kind != TokenKind::kWord) || !ParseTypeString(type_string, &type)) {
+        AddError(ErrorCode::kInvalidType, lexer, token);
+        return false;
+    }
+    const bool is_vector = (lexer->Peek().kind == TokenKind::kOpenBracket);
+    if (is_vector) {
+        lexer->Next();
+        token = lexer->Next();
+        if (token.kind != TokenKind::kCloseBracket) {
+            AddError(ErrorCode::kInvalidVectorType, lexer, token, VariableType{type, false});
+            return false;
+        }
+    }
+    // Read name
+    const Token key = lexer->Next();
+    const std::string_view name = key.text;
+    if (key.kind != TokenKind::kWord) {
+        AddError(ErrorCode::kInvalidName, lexer, key);
+        return false;
+    }
+    if (_var_map.Find(name) != nullptr) {
+        AddError(ErrorCode::kRedefinition, lexer, key, VariableType{}, &key);
+        return false;
+    }
+    // Verify equals sign is next
+    token = lexer->Next();
+    if (token.kind != TokenKind::kEquals) {
+        AddError(ErrorCode::kExpectedEquals, lexer, token, VariableType{}, &key);
+        return false;
+    }
+    const VariableType variable_type{type, is_vector};
+    size_t slot = 0;
+    if (_lazy_values && (is_vector || (type != ExpressionType::kBool))) {
+        // Record where the expression is, and skip to the end of the declaration
+        const std::string_view input = lexer->Input();
+        const size_t begin = static_cast<size_t>(token.text.data() - input.data()) + 1;
+        const size_t terminator = DeclarationScanner().FindTerminator(input, begin, begin);
+        const size_t end =
+                (terminator == DeclarationScanner::kNotFound) ? input.size() : terminator;
+        lexer->Seek(std::min(end + 1, input.size()));
+        const size_t array_index = ValueStore::SlotArrayIndex(variable_type);
+        slot = _values.AddDefault(array_index);
+        _lazy_values->values[array_index].emplace_back(begin, end, name);
+    } else {
+        uint64_t* value_nanoseconds = nullptr;
+        if (_stats) [[unlikely]] {
+            value_nanoseconds =
+                    &_stats->value_nanoseconds[ValueStore::SlotArrayIndex(variable_type)];
+        }
+        const PhaseTimer value_timer(value_nanoseconds);
+        if (!ParseExpression(lexer, variable_type, key, scratch, &_values, &slot)) return false;
+    }
+    _var_map.Insert(name, Variable{variable_type, 0, static_cast<uint32_t>(slot)});
+    if (_stats) [[unlikely]] _stats->AddDeclaration(name, variable_type, NanosecondsSince(start));
+    return true;
+}
+
+// Parses the expression of the declaration of key, of the given type, from just after its "=" up
+// to and including its terminating semicolon, and stores the value in values. Adds an error message
+// and returns false if the expression is invalid.
+bool ConfigParser::ParseExpression(Lexer* lexer,
+                                   VariableType variable_type,
+                                   const Token& key,
+                                   std::pmr::memory_resource* scratch,
+                                   ValueStore* values,
+                                   size_t* slot) const {
+    const ExpressionType type = variable_type.type;
+    // Read and parse the expression, storing the typed result
+    Token token = lexer->Next();
+    if (variable_type.is_vector) {
+        if (token.kind != TokenKind::kOpenBracket) {
+            AddError(ErrorCode::kVectorNotBracketed, lexer, token, VariableType{}, &key);
+            return false;
+        }
+        // Range parsers of a parallel parse have the default thread_count of 1, so this does not
+        // start threads within threads
+        const size_t thread_count = ResolveThreadCount(_options.thread_count);
+        if (!ParseVector(lexer, type, thread_count, scratch, values, slot, &token)) {
+            if (token.kind == TokenKind::kError) {
+                AddError(ErrorCode::kUnterminatedString, lexer, token, VariableType{}, &key);
+            } else if ((token.kind == TokenKind::kEnd) || (token.kind == TokenKind::kSemicolon)) {
+                AddError(ErrorCode::kVectorNotBracketed, lexer, token, VariableType{}, &key);
+            } else {
+                AddError(ErrorCode::kInvalidElement, lexer, token, variable_type, &key);
+            }
+            return false;
+        }
+    } else if (token.kind == TokenKind::kError) {
+        AddError(ErrorCode::kUnterminatedString, lexer, token, VariableType{}, &key);
+        return false;
+    } else if ((type == ExpressionType::kString) && (token.kind != TokenKind::kString)) {
+        AddError(ErrorCode::kStringNotQuoted, lexer, token, VariableType{}, &key);
+        return false;
+    } else if (!ParseValue(token.text, type, values, slot)) {
+        AddError(ErrorCode::kInvalidValue, lexer, token, variable_type, &key);
+        return false;
+    }
+    // We should now be at the end of the declaration
+    token = lexer->Next();
+    if ((token.kind != TokenKind::kSemicolon) && (token.kind != TokenKind::kEnd)) {
+        AddError(ErrorCode::kExpectedTerminator, lexer, token, VariableType{}, &key);
+        return false;
+    }
+    return true;
+}
+
+// Parses an include directive, `include "path";`, after its keyword. The path is relative to the
+// directory of this config's path or source name. Adds the variables of the included config, parsed
+// through the process-wide ParseCache, as if they were declared here. A config already included
+// (directly or indirectly) is not included again.
+bool ConfigParser::ParseInclude(Lexer* lexer, const Token& keyword) {
+    const Token path_token = lexer->Next();
+    if (path_token.kind != TokenKind::kString) {
+        AddError(ErrorCode::kIncludePathNotQuoted, lexer, path_token);
+        return false;
+    }
+    const Token token = lexer->Next();
+    if ((token.kind != TokenKind::kSemicolon) && (token.kind != TokenKind::kEnd)) {
+        AddError(ErrorCode::kExpectedTerminator, lexer, token);
+        return false;
+    }
+    const SourceLocation location = lexer->Locate(keyword);
+    const std::string_view path = path_token.text.substr(1, path_token.text.size() - 2);
+    const std::filesystem::path include_path(path);
+    if (include_path.is_relative() && _options.include_directory.empty()) {
+        AddError(ErrorCode::kRelativeInclude, location, keyword.text.size(), path);
+        return false;
+    }
+    std::error_code error;
+    const std::string canonical_path =
+            std::filesystem::canonical(
+                    std::filesystem::path(_options.include_directory) / include_path, error)
+                    .string();
+    if (error) {
+        AddError(ErrorCode::kIncludeNotFound, location, keyword.text.size(), path);
+        return false;
+    }
+    if (_include_chain.empty()) {
+        const std::filesystem::path own_path = std::filesystem::canonical(_config_path, error);
+        if (!error) _include_chain.push_back(own_path.string());
+    }
+    const auto cycle_start =
+            std::find(_include_chain.begin(), _include_chain.end(), canonical_path);
+    if (cycle_start != _include_chain.end()) {
+        std::string cycle;
+        for (auto chain_path = cycle_start; chain_path != _include_chain.end(); ++chain_path) {
+            cycle += *chain_path + " -> ";
+        }
+        AddError(ErrorCode::kIncludeCycle, location, keyword.text.size(), cycle + canonical_path);
+        return false;
+    }
+    const CachedConfig included = ParseCache::Global().Get(canonical_path, _include_chain);
+    if (!included.parser) {
+        AddError(ErrorCode::kIncludeNotFound, location, keyword.text.size(), path);
+        return false;
+    }
+    if (included.parser->ErrorCount() != 0) {
+        AddError(ErrorCode::kIncludeError, location, keyword.text.size(),
+                 included.parser->ErrorString());
+        return false;
+    }
+    return IncludeParser(included.parser, included.file, location);
+}
+
+// Adds the variables of an included config, sharing its values
+bool ConfigParser::IncludeParser(const std::shared_ptr<const ConfigParser>& included_parser,
+                                 const IncludedFile& included_file,
+                                 const SourceLocation& location) {
+    if (IsIncluded(included_parser)) return true;
+    if (_included_parsers.size() + included_parser->_included_parsers.size() >= UINT16_MAX) {
+        AddError(ErrorCode::kTooManyIncludes, location, kIncludeKeyword.size(), std::string_view());
+        return false;
+    }
+    // Sources of the included config's values in this parser. Configs it includes that were
+    // already included here, e.g. both sides of a diamond, have their variables declared already.
+    std::vector<uint16_t> sources = {AddIncludedParser(included_parser)};
+    std::vector<char> already_included = {false};
+    for (const std::shared_ptr<const ConfigParser>& indirectly_included_parser :
+         included_parser->_included_parsers) {
+        already_included.push_back(IsIncluded(indirectly_included_parser));
+        sources.push_back(AddIncludedParser(indirectly_included_parser));
+    }
+    for (const auto& [name, variable] : included_parser->_var_map) {
+        if (already_included[variable.source]) continue;
+        Variable included_variable = variable;
+        included_variable.source = sources[variable.source];
+        if (!_var_map.Insert(name, included_variable)) {
+            AddError(ErrorCode::kRedefinition, location, kIncludeKeyword.size(), name);
+            return false;
+        }
+    }
+    AddIncludedFile(included_file);
+    for (const IncludedFile& indirectly_included_file : included_parser->_included_files) {
+        AddIncludedFile(indirectly_included_file);
+    }
+    return true;
+}
+
+bool ConfigParser::IsIncluded(const std::shared_ptr<const ConfigParser>& included_parser) const {
+    return std::find(_included_parsers.begin(), _included_parsers.end(), included_parser) !=
+           _included_parsers.end();
+}
+
+// Returns the source index of the values of an included config, adding it if needed
+uint16_t ConfigParser::AddIncludedParser(
+        const std::shared_ptr<const ConfigParser>& included_parser) {
+    const auto existing =
+            std::find(_included_parsers.begin(), _included_parsers.end(), included_parser);
+    if (existing != _included_parsers.end()) {
+        return static_cast<uint16_t>(existing - _included_parsers.begin() + 1);
+    }
+    _included_parsers.push_back(included_parser);
+    return static_cast<uint16_t>(_included_parsers.size());
+}
+
+void ConfigParser::AddIncludedFile(const IncludedFile& included_file) {
+    const auto same_path = [&](const IncludedFile& file) {
+        return file.path == included_file.path;
+    };
+    if (std::none_of(_included_files.begin(), _included_files.end(), same_path)) {
+        _included_files.push_back(included_file);
+    }
+}
+
+void ConfigParser::AddError(const ConfigError& error, std::string_view text) const {
+    const std::lock_guard<std::mutex> lock(*_error_mutex);
+    ConfigError& added = _errors.emplace_back(error);
+    added.text_begin = static_cast<uint32_t>(_error_text.size());
+    added.text_size = static_cast<uint32_t>(text.size());
+    _error_text.append(text);
+}
+
+void ConfigParser::AddError(ErrorCode code,
+                            const SourceLocation& location,
+                            size_t size,
+                            std::string_view text,
+                            VariableType type) const {
+    ConfigError error{code, type};
+    error.line = static_cast<uint32_t>(location.line);
+    error.column = static_cast<uint32_t>(location.column);
+    error.offset = location.offset;
+    error.size = size;
+    AddError(error, text);
+}
+
+void ConfigParser::AddError(ErrorCode code,
+                            Lexer* lexer,
+                            const Token& token,
+                            VariableType type,
+                            const Token* key) const {
+    const SourceLocation location = lexer->Locate(token);
+    ConfigError error{code, type};
+    error.line = static_cast<uint32_t>(location.line);
+    error.column = static_cast<uint32_t>(location.column);
+    error.offset = location.offset;
+    error.size = token.text.size();
+    if (key != nullptr) {
+        error.key_offset = lexer->Offset(*key);
+        error.key_size = key->text.size();
+    }
+    AddError(error, token.text);
 }
@@ -10,6 +10,9 @@
  *     Values of type string are enclosed in ""s, and bool values are true/false.
  *   - A std::vector variable declaration has the format:
  *     <typename>[] <variable_name> = [<value_0>, <optional_newline><value_1>, ...]
+ *   - An include directive, include "<path>", declares the variables of another config file
+ *     there, with the path relative to the including file's directory. Included files are parsed
+ *     once per process and their values shared (see parse_cache.h).
  *
  * Sample config:
  *   # my_config.cfg
@@ -20,31 +23,442 @@
  *   ConfigParser config_parser("my_config.cfg");
  *   std::string message = config_parser.GetStringValue("message");
  *   std::vector<int> primes = config_parser.GetIntVector("primes");
+ *
+ * Configs can also be parsed from memory, or from a read-only mapping of the file:
+ *   ConfigParser from_buffer = ConfigParser::FromBuffer(embedded_config_string);
+ *   ConfigParser from_mapping = ConfigParser::FromMappedFile("my_config.cfg");
+ *
+ * Services that reload the same config often can enable a binary cache (see binary_cache.h), which
+ * is written next to the config file and used in place of parsing while the file is unchanged:
+ *   ConfigParser cached("my_config.cfg", ParseOptions{.use_binary_cache = true});
+ *
+ * The Get{Typename}View/Span methods return non-owning views instead of copies. The viewed data
+ * is owned by the ConfigParser and stays valid until the ConfigParser is destroyed (moving the
+ * ConfigParser does not invalidate views), e.g.:
+ *   std::span<const int> primes_view = config_parser.GetIntSpan("primes");
+ *
+ * Lookup<T> is the side-effect-free alternative to the getters (except for parsing values on first
+ * read with ParseOptions::lazy), returning the value (or a view of it) together with an error
+ * code, for use from many threads at once:
+ *   auto primes_lookup = config_parser.Lookup<std::vector<int>>("primes");
+ *   if (primes_lookup) use(primes_lookup.value());  // std::span<const int>
  */
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-// TODO: replace type_string and is_vector with enum everywhere possible
-// Make enum specify vector/non-vector types, or make a struct containing {Type, IsVector}
+#include "access_profile.h"
+#include "config_arena.h"
+#include "config_error.h"
+#include "mapped_file.h"
+#include "parse_stats.h"
+#include "variable_index.h"
+
+class Lexer;
+class ParseCache;
+class StreamingConfigParser;
+struct SourceLocation;
+struct Token;
+
+// Type in which a ValueStore holds values of config type T: strings and vectors are the
+// std::pmr versions, allocating from the store's memory resource
+template <typename T>
+struct StoredTypeTraits {
+    using Type = T;
+};
 
-// Attributes of a variable except for its name
-struct Variable {
-    std::string type_string;
-    bool is_vector;
-    std::string expression_string;
+template <>
+struct StoredTypeTraits<std::string> {
+    using Type = std::pmr::string;
 };
 
-enum class ExpressionType {
-    kString,
-    kInt,
-    kUint,
-    kFloat,
-    kDouble,
-    kBool,
+template <typename T>
+struct StoredTypeTraits<std::vector<T>> {
+    using Type = std::pmr::vector<typename StoredTypeTraits<T>::Type>;
+};
+
+template <typename T>
+using Stored = typename StoredTypeTraits<T>::Type;
+
+// Typed storage for parsed values, with one array per value type (scalar and vector).
+// Values are parsed once at load time, so getters only need to index into these arrays.
+// The arrays and the values in them allocate from the memory resource given at construction.
+class ValueStore {
+  public:
+    explicit ValueStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _slots(std::allocator_arg, std::pmr::polymorphic_allocator<std::byte>(resource)) {}
+
+    std::pmr::memory_resource* Resource() const {
+        return std::get<0>(_slots).get_allocator().resource();
+    }
+
+    // Array of the values of config type T
+    template <typename T>
+    std::pmr::vector<Stored<T>>& Slots() {
+        return std::get<std::pmr::vector<Stored<T>>>(_slots);
+    }
+
+    template <typename T>
+    const std::pmr::vector<Stored<T>>& Slots() const {
+        return std::get<std::pmr::vector<Stored<T>>>(_slots);
+    }
+
+    // Appends a value of config type T, constructed in place from args, to the array for its type
+    // and returns its slot index, e.g. Add<std::string>(string_view) or
+    // Add<std::vector<int>>(begin, end)
+    template <typename T, typename... Args>
+    size_t Add(Args&&... args) {
+        std::pmr::vector<Stored<T>>& slots = Slots<T>();
+        slots.emplace_back(std::forward<Args>(args)...);
+        return slots.size() - 1;
+    }
+
+    // Arrays are ordered by ExpressionType, scalars before vectors
+    static constexpr size_t kScalarTypeCount = 6;
+    static constexpr size_t kSlotArrayCount = 2 * kScalarTypeCount;
+    static size_t SlotArrayIndex(VariableType type) {
+        return static_cast<size_t>(type.type) + (type.is_vector ? kScalarTypeCount : 0);
+    }
+
+    // Number of values in each array, indexed by SlotArrayIndex
+    std::array<size_t, kSlotArrayCount> Sizes() const {
+        return std::apply(
+                [](const auto&... slots) {
+                    return std::array<size_t, kSlotArrayCount>{slots.size()...};
+                },
+                _slots);
+    }
+
+    // Appends a copy of the value in slot source_slot of the same array of source, and returns its
+    // slot index
+    size_t AddCopy(size_t array_index, const ValueStore& source, size_t source_slot) {
+        size_t slot = 0;
+        VisitArray(array_index, [&](auto& slots) {
+            slots.push_back(std::get<std::decay_t<decltype(slots)>>(source._slots)[source_slot]);
+            slot = slots.size() - 1;
+        });
+        return slot;
+    }
+
+    // Returns whether the value in slot of the array at array_index equals the value in slot
+    // other_slot of the same array of other
+    bool ValueEquals(size_t array_index,
+                     size_t slot,
+                     const ValueStore& other,
+                     size_t other_slot) const {
+        bool equal = false;
+        VisitArray(array_index, [&](const auto& slots) {
+            equal = (slots[slot] ==
+                     std::get<std::decay_t<decltype(slots)>>(other._slots)[other_slot]);
+        });
+        return equal;
+    }
+
+    // Appends a default-constructed value to the array at array_index (see SlotArrayIndex) and
+    // returns its slot index
+    size_t AddDefault(size_t array_index) {
+        size_t slot = 0;
+        VisitArray(array_index, [&](auto& slots) {
+            slots.emplace_back();
+            slot = slots.size() - 1;
+        });
+        return slot;
+    }
+
+    // Moves a value from slot source_slot of source to slot of the same array of this store
+    void MoveValue(size_t array_index, ValueStore* source, size_t source_slot, size_t slot) {
+        VisitArray(array_index, [&](auto& slots) {
+            slots[slot] = std::move(std::get<std::decay_t<decltype(slots)>>(source->_slots)
+                                            [source_slot]);
+        });
+    }
+
+    // Moves all values of other to the ends of the corresponding arrays of this store, so that
+    // their slot indices are offset by the previous Sizes(). Values are only copied if other
+    // allocates from a resource that does not compare equal to this store's.
+    void Append(ValueStore&& other) {
+        AppendArrays(&other, std::make_index_sequence<kSlotArrayCount>());
+    }
+
+  private:
+    // Calls function with the array at array_index
+    template <typename Function>
+    void VisitArray(size_t array_index, Function&& function) {
+        VisitArrayAt(_slots, array_index, function, std::make_index_sequence<kSlotArrayCount>());
+    }
+
+    template <typename Function>
+    void VisitArray(size_t array_index, Function&& function) const {
+        VisitArrayAt(_slots, array_index, function, std::make_index_sequence<kSlotArrayCount>());
+    }
+
+    template <typename Slots, typename Function, size_t... Indices>
+    static void VisitArrayAt(Slots& slots,
+                             size_t array_index,
+                             Function& function,
+                             std::index_sequence<Indices...>) {
+        ((array_index == Indices ? function(std::get<Indices>(slots)) : void()), ...);
+    }
+
+    template <size_t... Indices>
+    void AppendArrays(ValueStore* other, std::index_sequence<Indices...>) {
+        (AppendArray(&std::get<Indices>(_slots), &std::get<Indices>(other->_slots)), ...);
+    }
+
+    template <typename Array>
+    static void AppendArray(Array* slots, Array* other_slots) {
+        if (slots->empty()) {
+            *slots = std::move(*other_slots);
+        } else {
+            slots->insert(slots->end(), std::make_move_iterator(other_slots->begin()),
+                          std::make_move_iterator(other_slots->end()));
+        }
+    }
+
+    std::tuple<std::pmr::vector<Stored<std::string>>,
+               std::pmr::vector<int>,
+               std::pmr::vector<size_t>,
+               std::pmr::vector<float>,
+               std::pmr::vector<double>,
+               std::pmr::vector<bool>,
+               std::pmr::vector<Stored<std::vector<std::string>>>,
+               std::pmr::vector<Stored<std::vector<int>>>,
+               std::pmr::vector<Stored<std::vector<size_t>>>,
+               std::pmr::vector<Stored<std::vector<float>>>,
+               std::pmr::vector<Stored<std::vector<double>>>,
+               std::pmr::vector<Stored<std::vector<bool>>>>
+            _slots;
+};
+
+// Options for loading a config file
+struct ParseOptions {
+    // Load from the binary cache file <config_path>.cache when it matches the contents of the
+    // config file, and otherwise parse the config file and (if it has no errors) rewrite the cache
+    bool use_binary_cache = false;
+    // Number of threads to parse on, or 0 for one per hardware thread. Inputs are split at
+    // declaration boundaries into ranges of at least 1 MiB, so small configs are always parsed on
+    // the calling thread. When a config is not split, each large numeric vector is split into
+    // chunks of at least 256 KiB instead. Ranges parsed in parallel parse their vectors on their
+    // own thread, so at most thread_count threads run at once.
+    size_t thread_count = 1;
+    // Only index the declarations at load time, recording each variable's type and the location
+    // of its value, and parse each value the first time it is read. An invalid value is then
+    // reported when it is read, or by ConfigParser::ValidateAll. Reads stay thread-safe. Bool
+    // values are bit-packed, so they are still parsed at load time. Ignored with use_binary_cache,
+    // since writing the cache requires every value.
+    bool lazy = false;
+    // Record timing and size statistics of the load, read with ConfigParser::Stats (see
+    // parse_stats.h), keeping the slowest_declaration_count slowest declarations
+    bool collect_stats = false;
+    size_t slowest_declaration_count = 10;
+    // Count and time every getter call, lookup and handle read, for ConfigParser::ReportAccesses
+    // (see access_profile.h)
+    bool profile_access = false;
+    // Where the ConfigParser's arena takes its memory from (see config_arena.h), or nullptr for
+    // the global heap. Must outlive the ConfigParser.
+    std::pmr::memory_resource* memory_resource = nullptr;
+    // Continue past an invalid declaration at its terminating ';', rather than stopping, so that
+    // Errors lists every invalid declaration (see config_error.h). Only valid declarations are
+    // stored. The first error reported is the same either way.
+    bool collect_all_errors = false;
+    // Record a hash of the text of each declaration, so that the first ConfigParser::Reparse of
+    // this config only parses the declarations that changed. Costs hashing the input once.
+    bool reparsable = false;
+    // Directory that relative include paths are resolved against. Defaults to the directory of the
+    // config file. A config parsed from memory (FromBuffer, StreamingConfigParser) has no such
+    // directory, so unless this is set its relative includes are errors (kRelativeInclude),
+    // rather than depending on the working directory. Configs included by a config always resolve
+    // their own includes against their own directory.
+    std::string include_directory{};
+};
+
+// A file included by a config, directly or indirectly, and its state when it was parsed
+struct IncludedFile {
+    std::string path;  // canonical
+    std::filesystem::file_time_type write_time;
+    uintmax_t size;
+};
+
+// Variables that differ between two versions of a config, each in declaration order
+struct ConfigChanges {
+    std::vector<std::string> added;    // declared only in the new version
+    std::vector<std::string> removed;  // declared only in the old version
+    std::vector<std::string> changed;  // declared in both, with a different type or value
+
+    bool Empty() const { return added.empty() && removed.empty() && changed.empty(); }
+};
+
+// Source text and parse state of the values of a ConfigParser loaded with ParseOptions::lazy
+struct LazyValues {
+    // Location of an unparsed value in the source, and whether it has been parsed
+    struct Value {
+        size_t begin;  // just after the declaration's "="
+        size_t end;    // at the declaration's terminator, or the end of the source
+        std::string_view key;  // the variable's name, within the source
+        std::once_flag parsed;
+        bool valid = false;  // written under parsed
+    };
+
+    explicit LazyValues(std::string source_text)
+        : source_copy(std::move(source_text)), source(source_copy) {}
+    explicit LazyValues(std::unique_ptr<MappedFile> mapped_file)
+        : source_file(std::move(mapped_file)), source(source_file->Contents()) {}
+
+    std::string source_copy;                  // the source, when copied
+    std::unique_ptr<MappedFile> source_file;  // or a mapping of it
+    std::string_view source;
+    // Values indexed like the arrays of a ValueStore. Deques keep existing elements in place as
+    // values are added, since once_flags cannot be moved.
+    std::array<std::deque<Value>, ValueStore::kSlotArrayCount> values;
+};
+
+// Config value types: the type and vector-ness of the variables holding values of type T
+template <typename T>
+struct ConfigTypeTraits;
+
+template <ExpressionType Type>
+struct ConfigScalarTraits {
+    static constexpr ExpressionType kType = Type;
+    static constexpr bool kIsVector = false;
+    static constexpr VariableType kVariableType{kType, kIsVector};
+};
+
+template <>
+struct ConfigTypeTraits<std::string> : ConfigScalarTraits<ExpressionType::kString> {};
+template <>
+struct ConfigTypeTraits<int> : ConfigScalarTraits<ExpressionType::kInt> {};
+template <>
+struct ConfigTypeTraits<size_t> : ConfigScalarTraits<ExpressionType::kUint> {};
+template <>
+struct ConfigTypeTraits<float> : ConfigScalarTraits<ExpressionType::kFloat> {};
+template <>
+struct ConfigTypeTraits<double> : ConfigScalarTraits<ExpressionType::kDouble> {};
+template <>
+struct ConfigTypeTraits<bool> : ConfigScalarTraits<ExpressionType::kBool> {};
+
+template <typename T>
+struct ConfigTypeTraits<std::vector<T>> {
+    static constexpr ExpressionType kType = ConfigTypeTraits<T>::kType;
+    static constexpr bool kIsVector = true;
+    static constexpr VariableType kVariableType{kType, kIsVector};
+};
+
+// Non-owning view of a stored value of config type T: scalars are returned by value, strings as
+// std::string_view and vectors as std::span of their stored elements (std::pmr::string for
+// strings), except for std::vector<bool>, which is bit-packed and so is returned as a pointer to
+// the stored vector
+template <typename T>
+struct ValueViewTraits {
+    using Type = T;
+};
+
+template <>
+struct ValueViewTraits<std::string> {
+    using Type = std::string_view;
+};
+
+template <typename T>
+struct ValueViewTraits<std::vector<T>> {
+    using Type = std::span<const Stored<T>>;
+};
+
+template <>
+struct ValueViewTraits<std::vector<bool>> {
+    using Type = const Stored<std::vector<bool>>*;
+};
+
+template <typename T>
+using ValueView = typename ValueViewTraits<T>::Type;
+
+enum class LookupError {
+    kNone,
+    kNotFound,      // no variable has the given name
+    kWrongType,     // the variable has a different type
+    kInvalidValue,  // the variable's value failed to parse (lazy mode only)
+};
+
+// Formats the error message for a failed lookup of a variable of the given type.
+// found_variable is the variable with that name, if any.
+std::string FormatLookupError(LookupError error,
+                              std::string_view variable_name,
+                              VariableType expected_type,
+                              const Variable* found_variable);
+
+// Result of ConfigParser::Lookup<T>: either a view of the value, or the reason it was not found.
+// Holds views of the looked-up name and of the ConfigParser's storage, so it must not outlive
+// either of them.
+template <typename T>
+class LookupResult {
+  public:
+    using ValueType = ValueView<T>;
+
+    explicit LookupResult(ValueType value)
+        : _value(value), _error{LookupError::kNone}, _found_variable{nullptr} {}
+    LookupResult(LookupError error, std::string_view variable_name, const Variable* found_variable)
+        : _value{}, _error{error}, _variable_name(variable_name), _found_variable{found_variable} {}
+
+    bool has_value() const { return _error == LookupError::kNone; }
+    explicit operator bool() const { return has_value(); }
+
+    // The value; only meaningful if has_value()
+    const ValueType& value() const { return _value; }
+    const ValueType& operator*() const { return _value; }
+    ValueType value_or(ValueType default_value) const {
+        return has_value() ? _value : default_value;
+    }
+
+    LookupError error() const { return _error; }
+    // Describes why the lookup failed, or returns an empty string if it succeeded.
+    // The message is only formatted when this is called.
+    std::string ErrorString() const {
+        if (has_value()) return std::string();
+        return FormatLookupError(_error, _variable_name, ConfigTypeTraits<T>::kVariableType,
+                                 _found_variable);
+    }
+
+  private:
+    ValueType _value;
+    LookupError _error;
+    std::string_view _variable_name;
+    const Variable* _found_variable;
+};
+
+// Pre-resolved reference to a variable holding a value of type T, obtained with
+// ConfigParser::Resolve<T> and read with ConfigParser::Get. A handle is a slot index into the
+// typed value arrays, so reading through it needs no hashing or type check.
+template <typename T>
+class ValueHandle {
+  public:
+    // Constructs an invalid handle
+    ValueHandle() : _slot{kInvalidSlot}, _source{0} {}
+
+    bool IsValid() const { return _slot != kInvalidSlot; }
+
+  private:
+    friend class ConfigParser;
+    static constexpr size_t kInvalidSlot = static_cast<size_t>(-1);
+
+    explicit ValueHandle(const Variable& variable)
+        : _slot{variable.slot}, _source{variable.source} {}
+
+    size_t _slot;
+    uint16_t _source;
 };
 
 class ConfigParser {
@@ -52,6 +466,7 @@ class ConfigParser {
     // Syntax constants
     static const char kDeclarationTerminationChar;
     static const std::string kCommentPrefix;
+    static const std::string kIncludeKeyword;
     // Type names
     static const std::string kStringTypeString;
     static const std::string kIntTypeString;
@@ -66,43 +481,256 @@ class ConfigParser {
     static bool TypeStringIsValid(const std::string& type_string);
     static bool is_space(char c);
 
-    ConfigParser(const std::string& config_path);
+    static const std::string kBufferSourceName;
+    static const std::string kBinaryCacheSuffix;
+
+    ConfigParser(const std::string& config_path, const ParseOptions& options = ParseOptions());
+    ConfigParser(ConfigParser&&) = default;
+    // Destroys this config, releasing its arena, and takes over other's
+    ConfigParser& operator=(ConfigParser&& other) noexcept;
+
+    // Parses a config held in memory; the buffer only needs to outlive this call.
+    // source_name is used in place of the file path in error messages, and not to resolve
+    // relative includes, which need options.include_directory.
+    // (options.use_binary_cache does not apply to buffers.)
+    static ConfigParser FromBuffer(std::string_view contents,
+                                   const std::string& source_name = kBufferSourceName,
+                                   const ParseOptions& options = ParseOptions());
+    static ConfigParser FromBuffer(const char* data,
+                                   size_t size,
+                                   const std::string& source_name = kBufferSourceName,
+                                   const ParseOptions& options = ParseOptions());
+    // Parses a file through a read-only memory mapping, without copying its contents
+    static ConfigParser FromMappedFile(const std::string& config_path,
+                                       const ParseOptions& options = ParseOptions());
+
+    // Parses contents as a new version of the config that previous was parsed from, e.g. to
+    // reload a large config after a small edit. Declarations whose text is the same as when
+    // previous was parsed are not parsed again: their values are copied from previous. (Only
+    // Reparse and loads with ParseOptions::reparsable record declaration text; otherwise the first
+    // reparse of a config parses every declaration.) Each run of adjacent changed declarations is
+    // parsed as one range. If changes is not null, it is set to the variables that differ from
+    // previous.
+    // The result is the same as FromBuffer(contents) with the source name and options of previous
+    // (except for lazy, which does not apply); if contents has errors, it is parsed in full and
+    // changes is left empty. Changed declarations are parsed on the calling thread, so
+    // thread_count only applies to a full parse.
+    static ConfigParser Reparse(const ConfigParser& previous,
+                                std::string_view contents,
+                                ConfigChanges* changes = nullptr);
 
     size_t ErrorCount() const;
+    // Message of the first error, or an empty string if there are none
     std::string ErrorString() const;
+    // Messages of all errors, in the order they were found
+    std::vector<std::string> ErrorStrings() const;
+    // Records of all errors, in the order they were found (see config_error.h)
+    std::vector<ConfigError> Errors() const;
+    // Message of an error returned by Errors on this ConfigParser
+    std::string FormatError(const ConfigError& error) const;
+
+    // Looks up a variable holding a value of type T (one of std::string, int, size_t, float,
+    // double, bool, or a std::vector of one of these), e.g.:
+    //   LookupResult<float> height = config_parser.Lookup<float>("height");
+    //   if (!height) log(height.ErrorString());
+    // Lookups have no side effects and do not allocate, so they may be called concurrently from
+    // any number of threads without synchronization. A failed lookup is never recorded in the
+    // errors of this ConfigParser. The exception is ParseOptions::lazy: the first read of a value,
+    // by Lookup or any getter, parses it and stores it in this ConfigParser's arena, and records a
+    // parsing error if the value is invalid. That happens once per value, under the value's
+    // once_flag, so concurrent lookups remain safe and see the same result. With
+    // ParseOptions::profile_access, lookups also update the access counters.
+    template <typename T>
+    LookupResult<T> Lookup(std::string_view variable_name) const;
+
+    // Resolves a variable holding a value of type T to a handle, for repeated reads with Get, e.g.:
+    //   ValueHandle<float> height = config_parser.Resolve<float>("height");
+    //   float value = config_parser.Get(height);
+    // Returns an invalid handle, adding an error message like the getters, if no such variable
+    // exists. Slots are assigned in declaration order, so a handle can also be used with any other
+    // ConfigParser that has the same SchemaId, e.g. later snapshots of a ReloadableConfig whose
+    // values changed but whose declarations did not.
+    template <typename T>
+    ValueHandle<T> Resolve(const std::string& variable_name) const;
+
+    // Reads the value of a resolved variable; handle must be valid for this ConfigParser
+    template <typename T>
+    ValueView<T> Get(ValueHandle<T> handle) const {
+        const AccessProfile::HandleScope access(_access_profile.get(),
+                                                ConfigTypeTraits<T>::kVariableType, handle._source,
+                                                handle._slot);
+        if (_lazy_values) [[unlikely]] {
+            ParseLazyValue(Variable{ConfigTypeTraits<T>::kVariableType, handle._source,
+                                    static_cast<uint32_t>(handle._slot)});
+        }
+        return ViewSlot<T>(handle._source, handle._slot);
+    }
+
+    // Identifies the names, types and slots of all variables, which determine handle validity
+    uint64_t SchemaId() const;
 
-    // Note: getters are not `const` because they may add error messages
+    // With ParseOptions::lazy, parses every value not read yet and adds an error message for each
+    // invalid one, returning whether all are valid. Otherwise values were already checked at load
+    // time, and this returns true.
+    bool ValidateAll() const;
+
+    // Getters may also be called concurrently. A getter that finds its variable does not write to
+    // the ConfigParser; a miss adds its error message (see ErrorString) under a lock.
 
     // Single value getters
-    std::string GetString(const std::string& variable_name);
-    int GetInt(const std::string& variable_name);
-    size_t GetUint(const std::string& variable_name);
-    float GetFloat(const std::string& variable_name);
-    double GetDouble(const std::string& variable_name);
-    bool GetBool(const std::string& variable_name);
+    std::string GetString(const std::string& variable_name) const;
+    int GetInt(const std::string& variable_name) const;
+    size_t GetUint(const std::string& variable_name) const;
+    float GetFloat(const std::string& variable_name) const;
+    double GetDouble(const std::string& variable_name) const;
+    bool GetBool(const std::string& variable_name) const;
     // Vector getters
-    std::vector<std::string> GetStringVector(const std::string& variable_name);
-    std::vector<int> GetIntVector(const std::string& variable_name);
-    std::vector<size_t> GetUintVector(const std::string& variable_name);
-    std::vector<float> GetFloatVector(const std::string& variable_name);
-    std::vector<double> GetDoubleVector(const std::string& variable_name);
-    std::vector<bool> GetBoolVector(const std::string& variable_name);
+    std::vector<std::string> GetStringVector(const std::string& variable_name) const;
+    std::vector<int> GetIntVector(const std::string& variable_name) const;
+    std::vector<size_t> GetUintVector(const std::string& variable_name) const;
+    std::vector<float> GetFloatVector(const std::string& variable_name) const;
+    std::vector<double> GetDoubleVector(const std::string& variable_name) const;
+    std::vector<bool> GetBoolVector(const std::string& variable_name) const;
+    // Zero-copy getters, returning views into storage owned by this ConfigParser
+    // (std::vector<bool> is bit-packed, so bool vectors are only available through GetBoolVector)
+    std::string_view GetStringView(const std::string& variable_name) const;
+    std::span<const std::pmr::string> GetStringSpan(const std::string& variable_name) const;
+    std::span<const int> GetIntSpan(const std::string& variable_name) const;
+    std::span<const size_t> GetUintSpan(const std::string& variable_name) const;
+    std::span<const float> GetFloatSpan(const std::string& variable_name) const;
+    std::span<const double> GetDoubleSpan(const std::string& variable_name) const;
 
     // Shows direct result of parsing, useful for debugging
     void PrintVariableMap() const;
 
+    // Statistics of the load, or nullptr unless it was loaded with ParseOptions::collect_stats
+    const ParseStats* Stats() const { return _stats.get(); }
+    // Getter calls so far, with the hottest_key_count most read keys, if loaded with
+    // ParseOptions::profile_access (otherwise the report is empty, with enabled false). May be
+    // called while other threads call getters.
+    AccessReport ReportAccesses(size_t hottest_key_count = 20) const;
+
   private:
+    friend class LayeredConfig;
+    friend class ParseCache;
+    friend class StreamingConfigParser;
+
+    // Records _stats over the lifetime of a load, and sets up _access_profile at its end
+    class LoadScope;
+
+    // Constructs an empty parser allocating from arena, for use by the factory methods
+    explicit ConfigParser(std::unique_ptr<ConfigArena> arena = std::make_unique<ConfigArena>())
+        : _arena(std::move(arena)) {}
+
     // Helper member functions
 
-    bool CheckVariableExists(const std::string& variable_name,
-                             const std::string& expected_type_string,
-                             bool expected_is_vector);
+    void Parse(std::string_view contents, size_t thread_count);
+    bool ParseRange(std::string_view contents,
+                    size_t begin,
+                    size_t end,
+                    const SourceLocation& origin);
+    bool ParseDeclarations(Lexer* lexer, size_t end, std::pmr::memory_resource* scratch);
+    bool ParseRangesInParallel(std::string_view contents, size_t range_count);
+    void LoadWithBinaryCache(const ParseOptions& options);
+    void ParseLazily(std::unique_ptr<LazyValues> lazy_values);
+    bool ParseLazyValue(const Variable& variable) const;
+    bool ReparseDeclarations(const ConfigParser& previous,
+                             std::string_view contents,
+                             std::vector<char>* reused);
+    void FindChanges(const ConfigParser& previous,
+                     const std::vector<char>& reused,
+                     ConfigChanges* changes) const;
+
+    LookupError MatchVariable(std::string_view variable_name,
+                              VariableType expected_type,
+                              const Variable** variable) const;
+
+    // Lookup, without profiling
+    template <typename T>
+    LookupResult<T> FindValue(std::string_view variable_name) const;
+    // Looks up a variable like Lookup, recording the error in this ConfigParser on failure
+    template <typename T>
+    LookupResult<T> CheckedLookup(const std::string& variable_name) const;
+
+    // Store holding the values of variables with the given source (see Variable::source)
+    const ValueStore& Values(uint16_t source) const {
+        return (source == 0) ? _values : _included_parsers[source - 1]->_values;
+    }
+
+    template <typename T>
+    ValueView<T> ViewSlot(uint16_t source, size_t slot) const {
+        if constexpr (std::is_same_v<T, std::vector<bool>>) {
+            return &Values(source).Slots<T>()[slot];
+        } else {
+            return ValueView<T>(Values(source).Slots<T>()[slot]);
+        }
+    }
+
+    template <typename T>
+    T GetValue(const std::string& variable_name) const;
+    // Times a getter call until the returned scope ends, with ParseOptions::profile_access
+    AccessProfile::Scope ProfileAccess(Getter getter, const std::string& variable_name) const {
+        return AccessProfile::Scope(_access_profile.get(), getter, _var_map, variable_name);
+    }
+
+    bool ParseDeclaration(Lexer* lexer, std::pmr::memory_resource* scratch);
+    bool ParseInclude(Lexer* lexer, const Token& keyword);
+    bool IncludeParser(const std::shared_ptr<const ConfigParser>& included_parser,
+                       const IncludedFile& included_file,
+                       const SourceLocation& location);
+    bool IsIncluded(const std::shared_ptr<const ConfigParser>& included_parser) const;
+    uint16_t AddIncludedParser(const std::shared_ptr<const ConfigParser>& included_parser);
+    void AddIncludedFile(const IncludedFile& included_file);
+    bool ParseExpression(Lexer* lexer,
+                         VariableType variable_type,
+                         const Token& key,
+                         std::pmr::memory_resource* scratch,
+                         ValueStore* values,
+                         size_t* slot) const;
 
-    void AddErrorMessage(const std::string& error_message);
+    // Records an error, copying the text its message quotes
+    void AddError(const ConfigError& error, std::string_view text) const;
+    // Records an error at token, quoting its text, in the declaration of key if not null
+    void AddError(ErrorCode code,
+                  Lexer* lexer,
+                  const Token& token,
+                  VariableType type = VariableType{},
+                  const Token* key = nullptr) const;
+    // Records an error at location, of a token of the given size
+    void AddError(ErrorCode code,
+                  const SourceLocation& location,
+                  size_t size,
+                  std::string_view text,
+                  VariableType type = VariableType{}) const;
+    // Text quoted by the message of one of _errors, under _error_mutex
+    std::string_view ErrorText(const ConfigError& error) const {
+        return std::string_view(_error_text).substr(error.text_begin, error.text_size);
+    }
 
     // Member variables
+    // Memory of _var_map and _values; declared first so that it is destroyed last
+    std::unique_ptr<ConfigArena> _arena;
     std::string _config_path;
-    std::unordered_map<std::string, Variable> _var_map;
-    std::vector<std::string> _error_messages;
-    int _line_number;  // note: currently innaccurate because of preprocessing
+    ParseOptions _options;  // options it was loaded with, which Reparse carries over
+    VariableIndex _var_map{_arena.get()};
+    // Mutable only so that lazily parsed values can be stored on first access, each under its own
+    // once_flag in _lazy_values
+    mutable ValueStore _values{_arena.get()};
+    std::unique_ptr<LazyValues> _lazy_values;  // set with ParseOptions::lazy
+    // Hash of the text of each variable's declaration, in declaration order (recorded by Reparse
+    // and with ParseOptions::reparsable)
+    std::vector<uint64_t> _declaration_hashes;
+    // Included configs whose values are shared by this one, directly or indirectly included
+    std::vector<std::shared_ptr<const ConfigParser>> _included_parsers;
+    std::vector<IncludedFile> _included_files;
+    // Canonical paths of this config and the configs including it, innermost last, for detecting
+    // include cycles (empty until needed for a config loaded directly)
+    std::vector<std::string> _include_chain;
+    // Lookup misses in const getters also record errors, under _error_mutex (heap-allocated so
+    // that ConfigParser stays movable)
+    mutable std::vector<ConfigError> _errors;
+    mutable std::string _error_text;  // text quoted by the messages of _errors
+    mutable std::unique_ptr<std::mutex> _error_mutex = std::make_unique<std::mutex>();
+    std::unique_ptr<ParseStats> _stats;  // set with ParseOptions::collect_stats
+    std::unique_ptr<AccessProfile> _access_profile;  // set with ParseOptions::profile_access
 };
@@ -0,0 +1,97 @@
+/* Compile-time binding of config variables to the members of a struct.
+ *
+ * A schema lists the config name of each member; the config type of each variable follows from the
+ * member's type, so members of types the config format cannot hold are compile errors:
+ *   struct Dimensions {
+ *       float height;
+ *       std::vector<int> primes;
+ *   };
+ *   constexpr auto kDimensionsSchema =
+ *           MakeConfigSchema(ConfigField{"height", &Dimensions::height},
+ *                            ConfigField{"primes", &Dimensions::primes});
+ *
+ * BindConfig then fills a struct from a parsed config in one pass over the schema, after which the
+ * values are plain member reads. Every missing or mistyped variable is reported at once:
+ *   Dimensions dimensions;
+ *   std::vector<std::string> errors = BindConfig(config_parser, kDimensionsSchema, &dimensions);
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "config_parser.h"
+
+// Types that a config variable can hold
+template <typename T>
+concept ConfigValueType = requires {
+    ConfigTypeTraits<T>::kType;
+    ConfigTypeTraits<T>::kIsVector;
+};
+
+// Binding of the config variable `name` to the member `member` of Struct
+template <typename Struct, ConfigValueType T>
+struct ConfigField {
+    std::string_view name;
+    T Struct::*member;
+};
+
+template <typename Struct, typename... Fields>
+struct ConfigSchema {
+    std::tuple<Fields...> fields;
+};
+
+template <typename Struct, typename... Types>
+constexpr ConfigSchema<Struct, ConfigField<Struct, Types>...> MakeConfigSchema(
+        ConfigField<Struct, Types>... fields) {
+    return ConfigSchema<Struct, ConfigField<Struct, Types>...>{std::tuple(fields...)};
+}
+
+namespace config_schema_detail {
+
+// Copies a value out of the view returned by a lookup
+template <typename T>
+T CopyValue(const ValueView<T>& view) {
+    if constexpr (std::is_same_v<T, std::vector<bool>>) {
+        return T(view->begin(), view->end());
+    } else if constexpr (ConfigTypeTraits<T>::kIsVector) {
+        return T(view.begin(), view.end());
+    } else {
+        return T(view);
+    }
+}
+
+template <typename Struct, typename T>
+void BindField(const ConfigParser& config_parser,
+               const ConfigField<Struct, T>& field,
+               Struct* out,
+               std::vector<std::string>* errors) {
+    const LookupResult<T> result = config_parser.Lookup<T>(field.name);
+    if (!result) {
+        errors->push_back(result.ErrorString());
+        return;
+    }
+    out->*field.member = CopyValue<T>(result.value());
+}
+
+}  // namespace config_schema_detail
+
+// Fills the members of *out listed in schema from config_parser. Returns an error message for each
+// variable that is missing or has a different type (the corresponding members are left unchanged),
+// or an empty vector if all members were filled.
+template <typename Struct, typename... Fields>
+std::vector<std::string> BindConfig(const ConfigParser& config_parser,
+                                    const ConfigSchema<Struct, Fields...>& schema,
+                                    Struct* out) {
+    std::vector<std::string> errors;
+    std::apply(
+            [&](const auto&... fields) {
+                (config_schema_detail::BindField(config_parser, fields, out, &errors), ...);
+            },
+            schema.fields);
+    return errors;
+}
@@ -0,0 +1,173 @@
+#include "config_set.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace {
+
+/** Work-stealing thread pool **/
+
+// Range of task indices owned by one worker. The owner takes tasks from the front, and other
+// workers steal from the back.
+struct TaskQueue {
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+// Takes the next task from the front of a worker's own queue
+bool PopTask(TaskQueue* queue, size_t* task) {
+    const std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->begin == queue->end) return false;
+    *task = queue->begin++;
+    return true;
+}
+
+// Moves the back half of the largest other queue into the (empty) queue of worker thief
+bool StealTasks(std::vector<TaskQueue>* queues, size_t thief) {
+    while (true) {
+        // Pick the victim with the most remaining tasks; sizes may change before it is locked
+        size_t victim = thief, victim_size = 0;
+        for (size_t i = 0; i < queues->size(); ++i) {
+            if (i == thief) continue;
+            const std::lock_guard<std::mutex> lock((*queues)[i].mutex);
+            const size_t size = (*queues)[i].end - (*queues)[i].begin;
+            if (size > victim_size) {
+                victim = i;
+                victim_size = size;
+            }
+        }
+        if (victim_size == 0) return false;
+        TaskQueue& victim_queue = (*queues)[victim];
+        TaskQueue& thief_queue = (*queues)[thief];
+        const std::scoped_lock lock(victim_queue.mutex, thief_queue.mutex);
+        const size_t size = victim_queue.end - victim_queue.begin;
+        if (size == 0) continue;  // emptied in the meantime, look again
+        const size_t stolen = (size + 1) / 2;
+        thief_queue.begin = victim_queue.end - stolen;
+        thief_queue.end = victim_queue.end;
+        victim_queue.end -= stolen;
+        return true;
+    }
+}
+
+// Runs task(i) for every i in [0, task_count) on up to thread_count threads (including the
+// calling thread). Each thread starts with a contiguous share of the indices, and threads that
+// run out of work steal from the others, so uneven task costs are balanced.
+void ParallelFor(size_t task_count, size_t thread_count, const std::function<void(size_t)>& task) {
+    thread_count = std::max<size_t>(1, std::min(thread_count, task_count));
+    std::vector<TaskQueue> queues(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues[i].begin = task_count * i / thread_count;
+        queues[i].end = task_count * (i + 1) / thread_count;
+    }
+    const auto worker = [&](size_t worker_index) {
+        size_t task_index = 0;
+        do {
+            while (PopTask(&queues[worker_index], &task_index)) task(task_index);
+        } while (StealTasks(&queues, worker_index));
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) threads.emplace_back(worker, i);
+    worker(0);
+    for (std::thread& thread : threads) thread.join();
+}
+
+/** Path patterns **/
+
+// Matches name against a pattern in which * matches any run of characters and ? any character
+bool WildcardMatch(std::string_view name, std::string_view pattern) {
+    size_t name_index = 0, pattern_index = 0;
+    // Position to resume from after the last *, trying successively longer runs for it
+    size_t star_pattern_index = std::string_view::npos, star_name_index = 0;
+    while (name_index < name.size()) {
+        if ((pattern_index < pattern.size()) &&
+            ((pattern[pattern_index] == '?') || (pattern[pattern_index] == name[name_index]))) {
+            ++name_index;
+            ++pattern_index;
+        } else if ((pattern_index < pattern.size()) && (pattern[pattern_index] == '*')) {
+            star_pattern_index = pattern_index++;
+            star_name_index = name_index;
+        } else if (star_pattern_index != std::string_view::npos) {
+            pattern_index = star_pattern_index + 1;
+            name_index = ++star_name_index;
+        } else {
+            return false;
+        }
+    }
+    while ((pattern_index < pattern.size()) && (pattern[pattern_index] == '*')) ++pattern_index;
+    return pattern_index == pattern.size();
+}
+
+}  // namespace
+
+ConfigSet ConfigSet::Load(const std::vector<std::string>& config_paths,
+                          const ParseOptions& options,
+                          size_t thread_count) {
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // Each file is parsed on a single thread of the pool, without starting threads of its own
+    ParseOptions file_options = options;
+    file_options.thread_count = 1;
+    std::vector<std::optional<ConfigParser>> parsers(config_paths.size());
+    ParallelFor(config_paths.size(), thread_count,
+                [&](size_t i) { parsers[i].emplace(config_paths[i], file_options); });
+    ConfigSet config_set;
+    config_set._paths = config_paths;
+    config_set._parsers.reserve(parsers.size());
+    for (std::optional<ConfigParser>& parser : parsers) {
+        config_set._parsers.push_back(std::move(*parser));
+    }
+    return config_set;
+}
+
+ConfigSet ConfigSet::LoadGlob(const std::string& path_pattern,
+                              const ParseOptions& options,
+                              size_t thread_count) {
+    namespace fs = std::filesystem;
+    const fs::path pattern_path(path_pattern);
+    const fs::path directory = pattern_path.has_parent_path() ? pattern_path.parent_path() : ".";
+    const std::string file_pattern = pattern_path.filename().string();
+    std::vector<std::string> config_paths;
+    std::error_code error;
+    for (const fs::directory_entry& entry : fs::directory_iterator(directory, error)) {
+        if (entry.is_regular_file(error) &&
+            WildcardMatch(entry.path().filename().string(), file_pattern)) {
+            config_paths.push_back(
+                    pattern_path.has_parent_path() ? entry.path().string()
+                                                   : entry.path().filename().string());
+        }
+    }
+    std::sort(config_paths.begin(), config_paths.end());
+    return Load(config_paths, options, thread_count);
+}
+
+const ConfigParser* ConfigSet::Find(const std::string& config_path) const {
+    const auto it = std::find(_paths.begin(), _paths.end(), config_path);
+    return (it == _paths.end()) ? nullptr : &_parsers[it - _paths.begin()];
+}
+
+size_t ConfigSet::ErrorCount() const {
+    size_t error_count = 0;
+    for (const ConfigParser& parser : _parsers) error_count += parser.ErrorCount();
+    return error_count;
+}
+
+std::string ConfigSet::ErrorString() const {
+    for (const ConfigParser& parser : _parsers) {
+        if (parser.ErrorCount()) return parser.ErrorString();
+    }
+    return std::string("");
+}
+
+std::vector<std::string> ConfigSet::ErrorStrings() const {
+    std::vector<std::string> error_strings;
+    for (const ConfigParser& parser : _parsers) {
+        if (parser.ErrorCount()) error_strings.push_back(parser.ErrorString());
+    }
+    return error_strings;
+}
@@ -0,0 +1,50 @@
+/* Concurrent loading of many config files.
+ *
+ * Each file is parsed into its own ConfigParser, with files spread over a pool of threads (each
+ * file is parsed on a single thread). Results are in the order of the given paths regardless of
+ * which thread parsed them, e.g.:
+ *   ConfigSet config_set = ConfigSet::LoadGlob("sweep/run_*.cfg");
+ *   if (config_set.ErrorCount()) std::cerr << config_set.ErrorString() << std::endl;
+ *   for (size_t i = 0; i < config_set.Size(); ++i) run(config_set.Parser(i));
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "config_parser.h"
+
+class ConfigSet {
+  public:
+    // Parses the files at config_paths concurrently on up to thread_count threads, or one per
+    // hardware thread if thread_count is 0 (options.thread_count is ignored, since each file is
+    // parsed on a single thread)
+    static ConfigSet Load(const std::vector<std::string>& config_paths,
+                          const ParseOptions& options = ParseOptions(),
+                          size_t thread_count = 0);
+    // Parses the files matching a path pattern whose last component may contain the wildcards
+    // * and ?, e.g. "configs/run_*.cfg". Files are ordered by path.
+    static ConfigSet LoadGlob(const std::string& path_pattern,
+                              const ParseOptions& options = ParseOptions(),
+                              size_t thread_count = 0);
+
+    size_t Size() const { return _parsers.size(); }
+    const std::string& Path(size_t index) const { return _paths[index]; }
+    const ConfigParser& Parser(size_t index) const { return _parsers[index]; }
+    // Returns the parser for the file loaded from config_path, or nullptr if there is none
+    const ConfigParser* Find(const std::string& config_path) const;
+
+    // Total number of errors over all files
+    size_t ErrorCount() const;
+    // First error of the first file with errors, or an empty string if there are none
+    std::string ErrorString() const;
+    // First error of each file with errors, in file order
+    std::vector<std::string> ErrorStrings() const;
+
+  private:
+    ConfigSet() = default;
+
+    std::vector<std::string> _paths;
+    std::vector<ConfigParser> _parsers;
+};
@@ -0,0 +1,887 @@
+/* Assertion-based tests of the config parser, run with ctest.
+ *
+ * Each test function checks one feature against an independent way of getting the same result,
+ * e.g. a config fed in random chunks against the same config parsed in one piece. A failed check
+ * prints its location and expression, and the run exits with a non-zero status once every test has
+ * run. Usage:
+ *   config_test
+ * Files are written to a temporary directory, which is removed afterwards.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "config_error.h"
+#include "config_parser.h"
+#include "config_set.h"
+#include "layered_config.h"
+#include "numeric_parsing.h"
+#include "reloadable_config.h"
+#include "streaming_parser.h"
+
+namespace {
+
+size_t failure_count = 0;
+
+#define CHECK(condition)                                                                    \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            ++failure_count;                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+        }                                                                                   \
+    } while (false)
+
+/** Helpers **/
+
+// Temporary directory for config files, removed when destroyed
+class TempDirectory {
+  public:
+    TempDirectory() {
+        std::random_device random;
+        _path = std::filesystem::temp_directory_path() /
+                ("config_test_" + std::to_string(random()) + std::to_string(random()));
+        std::filesystem::create_directories(_path);
+    }
+    ~TempDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(_path, error);
+    }
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    std::string Directory() const { return _path.string(); }
+    // Path of the file name in this directory
+    std::string Path(const std::string& name) const { return (_path / name).string(); }
+    // Writes contents to the file name in this directory, returning its path
+    std::string Write(const std::string& name, std::string_view contents) const {
+        const std::string path = Path(name);
+        std::ofstream(path, std::ios::binary) << contents;
+        return path;
+    }
+
+  private:
+    std::filesystem::path _path;
+};
+
+// Declaration types of the generated configs, one per type of value
+constexpr std::string_view kGeneratedTypes[] = {"int", "float", "string", "bool", "int[]",
+                                                "double[]", "string[]", "bool[]"};
+constexpr size_t kGeneratedTypeCount = std::size(kGeneratedTypes);
+
+// Config of count declarations cycling through kGeneratedTypes, named v0, v1, ..., with
+// comments, empty vectors and strings holding delimiters in between
+std::string GenerateConfig(size_t count) {
+    std::string contents = "# generated\n";
+    for (size_t i = 0; i < count; ++i) {
+        const std::string n = std::to_string(i);
+        contents += std::string(kGeneratedTypes[i % kGeneratedTypeCount]) + " v" + n + " = ";
+        switch (i % kGeneratedTypeCount) {
+            case 0: contents += n; break;
+            case 1: contents += n + ".5"; break;
+            case 2: contents += "\"s;" + n + " # [x]\""; break;
+            case 3: contents += (i % 2 == 0) ? "true" : "false"; break;
+            case 4: contents += (i % 3 == 0) ? "[]" : "[1, -2, " + n + "]"; break;
+            case 5: contents += "[" + n + ".25, 1e3]"; break;
+            case 6: contents += (i % 3 == 0) ? "[]" : "[\"a,b\", \"" + n + "\"]"; break;
+            default: contents += "[true, false]"; break;
+        }
+        contents += (i % 5 == 0) ? ";  # comment; with a terminator\n" : ";\n";
+    }
+    return contents;
+}
+
+// Checks that both configs have the variables of GenerateConfig(count), with the same values
+void CheckSameGeneratedValues(const ConfigParser& actual, const ConfigParser& expected,
+                              size_t count) {
+    CHECK(actual.SchemaId() == expected.SchemaId());
+    size_t mismatch_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string name = std::string("v").append(std::to_string(i));
+        bool same = false;
+        switch (i % kGeneratedTypeCount) {
+            case 0: same = *actual.Lookup<int>(name) == *expected.Lookup<int>(name); break;
+            case 1: same = *actual.Lookup<float>(name) == *expected.Lookup<float>(name); break;
+            case 2:
+                same = *actual.Lookup<std::string>(name) == *expected.Lookup<std::string>(name);
+                break;
+            case 3: same = *actual.Lookup<bool>(name) == *expected.Lookup<bool>(name); break;
+            case 4:
+                same = actual.GetIntVector(name) == expected.GetIntVector(name);
+                break;
+            case 5:
+                same = actual.GetDoubleVector(name) == expected.GetDoubleVector(name);
+                break;
+            case 6:
+                same = actual.GetStringVector(name) == expected.GetStringVector(name);
+                break;
+            default:
+                same = actual.GetBoolVector(name) == expected.GetBoolVector(name);
+                break;
+        }
+        if (!same) ++mismatch_count;
+    }
+    CHECK(mismatch_count == 0);
+}
+
+// Sum of the declaration counts of stats
+size_t DeclarationCount(const ParseStats& stats) {
+    return std::accumulate(stats.declaration_counts.begin(), stats.declaration_counts.end(),
+                           size_t{0});
+}
+
+// Whether error is at the line and column of its offset in contents, counted character by
+// character
+bool LocatedAtOffset(const ConfigError& error, std::string_view contents) {
+    if (error.offset > contents.size()) return false;
+    const std::string_view before = contents.substr(0, error.offset);
+    const size_t line = 1 + std::count(before.begin(), before.end(), '\n');
+    const size_t last_newline = before.rfind('\n');
+    const size_t column =
+            error.offset - ((last_newline == std::string_view::npos) ? 0 : last_newline + 1) + 1;
+    return (error.line == line) && (error.column == column);
+}
+
+// Whether ParseNumber parses input to exactly the value std::from_chars does
+template <typename T>
+bool ParsesLikeFromChars(std::string_view input) {
+    T expected{};
+    const std::from_chars_result result =
+            std::from_chars(input.data(), input.data() + input.size(), expected);
+    const bool expected_valid =
+            (result.ec == std::errc()) && (result.ptr == input.data() + input.size());
+    T actual{};
+    const bool valid = ParseNumber(input, &actual);
+    if (valid != expected_valid) return false;
+    // Compared bit for bit, so that the sign of zero counts
+    using Bits = std::conditional_t<sizeof(T) == sizeof(uint32_t), uint32_t, uint64_t>;
+    return !valid || (std::bit_cast<Bits>(actual) == std::bit_cast<Bits>(expected));
+}
+
+// Waits up to a few seconds for config to publish version; returns whether it did
+bool WaitForVersion(const ReloadableConfig& config, size_t version) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (config.Version() < version) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+/** Tests **/
+
+void TestNumericParsing() {
+    int int_value = 0;
+    size_t uint_value = 0;
+    float float_value = 0;
+    double double_value = 0;
+    // Signs: one leading '+' or '-', and no '-' for unsigned values
+    CHECK(ParseNumber("+5", &int_value) && (int_value == 5));
+    CHECK(ParseNumber("-5", &int_value) && (int_value == -5));
+    CHECK(ParseNumber("+5", &uint_value) && (uint_value == 5));
+    CHECK(ParseNumber("+2.5", &double_value) && (double_value == 2.5));
+    for (const char* input : {"+-5", "-+5", "--5", "++5", "+", "-", ""}) {
+        CHECK(!ParseNumber(input, &int_value));
+        CHECK(!ParseNumber(input, &uint_value));
+        CHECK(!ParseNumber(input, &double_value));
+    }
+    CHECK(!ParseNumber("-5", &uint_value));
+    CHECK(!ParseNumber("-0", &uint_value));
+
+    // Overflow, on both sides of the digits10 fast path boundary
+    CHECK(ParseNumber("999999999", &int_value) && (int_value == 999999999));
+    CHECK(ParseNumber("2147483647", &int_value) && (int_value == 2147483647));
+    CHECK(ParseNumber("-2147483648", &int_value) &&
+          (int_value == std::numeric_limits<int>::min()));
+    CHECK(!ParseNumber("2147483648", &int_value));
+    CHECK(!ParseNumber("-2147483649", &int_value));
+    CHECK(!ParseNumber("99999999999", &int_value));
+    CHECK(ParseNumber("0000000000012", &int_value) && (int_value == 12));
+    CHECK(ParseNumber("9999999999999999999", &uint_value) &&
+          (uint_value == 9999999999999999999u));
+    CHECK(ParseNumber("18446744073709551615", &uint_value) &&
+          (uint_value == std::numeric_limits<size_t>::max()));
+    CHECK(!ParseNumber("18446744073709551616", &uint_value));
+    CHECK(!ParseNumber("1e40", &float_value));
+    CHECK(!ParseNumber("1e400", &double_value));
+
+    // Trailing and embedded garbage
+    for (const char* input : {"12x", "1 2", "12 ", " 12", "0x10", "1,5", "1.5.", "1e", "1e+"}) {
+        CHECK(!ParseNumber(input, &int_value));
+        CHECK(!ParseNumber(input, &double_value));
+    }
+    CHECK(!ParseNumber("1.5", &int_value));
+    CHECK(!ParseNumber("1e3", &int_value));
+
+    // Special values and abbreviated decimals
+    CHECK(ParseNumber("inf", &double_value) && std::isinf(double_value) && (double_value > 0));
+    CHECK(ParseNumber("-inf", &float_value) && std::isinf(float_value) && (float_value < 0));
+    CHECK(ParseNumber("+inf", &double_value) && std::isinf(double_value));
+    CHECK(ParseNumber("nan", &double_value) && std::isnan(double_value));
+    CHECK(!ParseNumber("inf", &int_value));
+    CHECK(ParseNumber(".5", &double_value) && (double_value == 0.5));
+    CHECK(ParseNumber("-.5", &float_value) && (float_value == -0.5f));
+    CHECK(ParseNumber("1.", &double_value) && (double_value == 1.0));
+    CHECK(!ParseNumber(".", &double_value));
+    CHECK(ParseNumber("-0.0", &double_value) && (double_value == 0) && std::signbit(double_value));
+
+    // Rounding matches std::from_chars, on and around the fast path's digit limits and the powers
+    // of ten it divides by
+    for (const char* input : {"0.1", "0.3", "1.0000001", "16777217", "3.4028235e38", "1e22",
+                              "1e23", "9007199254740993", "0.1234567", "1234567.1", "1e-10",
+                              "0.0000000001", "0.00000000001", "123456789012345.6",
+                              "0.000000000000000000001", "0.0000000000000000000001",
+                              "4.9e-324", "2.2250738585072011e-308", "1.7976931348623157e308"}) {
+        CHECK(ParsesLikeFromChars<float>(input));
+        CHECK(ParsesLikeFromChars<double>(input));
+    }
+    std::mt19937_64 random(12345);
+    size_t mismatch_count = 0;
+    for (size_t i = 0; i < 200000; ++i) {
+        // 1 to 17 digits, with the point anywhere or absent, and sometimes an exponent
+        const size_t digit_count = 1 + random() % 17;
+        std::string input = (random() % 4 == 0) ? "-" : "";
+        const size_t point = random() % (digit_count + 2);
+        for (size_t digit = 0; digit < digit_count; ++digit) {
+            if (digit == point) input += '.';
+            input += static_cast<char>('0' + random() % 10);
+        }
+        if (random() % 8 == 0) input.append("e").append(std::to_string(int(random() % 50) - 25));
+        if (!ParsesLikeFromChars<float>(input) || !ParsesLikeFromChars<double>(input)) {
+            ++mismatch_count;
+        }
+    }
+    CHECK(mismatch_count == 0);
+}
+
+void TestStreamingMatchesOneShot() {
+    const std::string valid = GenerateConfig(400);
+    const std::string invalid = valid + "int broken = 1x;\nint after = 2;\n";
+    std::mt19937 random(12345);
+    for (const std::string& contents : {valid, invalid}) {
+        const ConfigParser one_shot = ConfigParser::FromBuffer(contents, "stream");
+        for (size_t max_chunk_size : {1, 7, 64, 4096}) {
+            StreamingConfigParser streaming_parser("stream");
+            std::uniform_int_distribution<size_t> chunk_size(1, max_chunk_size);
+            for (size_t position = 0; position < contents.size();) {
+                const size_t size = std::min(chunk_size(random), contents.size() - position);
+                streaming_parser.Feed(std::string_view(contents).substr(position, size));
+                position += size;
+            }
+            const ConfigParser streamed = streaming_parser.Finish();
+            CHECK(streamed.ErrorStrings() == one_shot.ErrorStrings());
+            if (one_shot.ErrorCount() == 0) CheckSameGeneratedValues(streamed, one_shot, 400);
+        }
+    }
+}
+
+void TestParallelMatchesSequential() {
+    // Large enough (over 3 MiB) to be split into several ranges
+    constexpr size_t kCount = 150000;
+    const std::string valid = GenerateConfig(kCount);
+    CHECK(valid.size() > (size_t{3} << 20));
+    const ConfigParser sequential = ConfigParser::FromBuffer(valid, "config");
+    const ConfigParser parallel =
+            ConfigParser::FromBuffer(valid, "config", ParseOptions{.thread_count = 4});
+    CHECK(sequential.ErrorCount() == 0);
+    CHECK(parallel.ErrorCount() == 0);
+    CheckSameGeneratedValues(parallel, sequential, kCount);
+
+    // An error late in the input, and a redefinition across ranges
+    for (const std::string& invalid :
+         {valid + "float broken = 1..2;\n", valid + "int v0 = 1;\n"}) {
+        for (bool collect_all_errors : {false, true}) {
+            const ParseOptions sequential_options{.collect_all_errors = collect_all_errors};
+            const ParseOptions parallel_options{.thread_count = 4,
+                                                .collect_all_errors = collect_all_errors};
+            const ConfigParser sequential_invalid =
+                    ConfigParser::FromBuffer(invalid, "config", sequential_options);
+            const ConfigParser parallel_invalid =
+                    ConfigParser::FromBuffer(invalid, "config", parallel_options);
+            CHECK(sequential_invalid.ErrorCount() == 1);
+            CHECK(parallel_invalid.ErrorStrings() == sequential_invalid.ErrorStrings());
+        }
+    }
+}
+
+void TestParallelVectorMatchesSequential() {
+    // Vectors of several MiB, each the only declaration of its config so that the config is not
+    // split into ranges and the vector's chunks are parsed in parallel instead
+    std::string ints = "int[] ints = [";
+    std::string doubles = "double[] doubles = [";
+    constexpr size_t kElementCount = 600000;
+    for (size_t i = 0; i < kElementCount; ++i) {
+        const char* separator = (i % 16 == 15) ? ",\n" : ", ";
+        ints.append(std::to_string(i * 7919 % 1000003)).append(separator);
+        doubles.append(std::to_string(i)).append(".125e-3").append(separator);
+    }
+    ints += "-1];\n";
+    doubles += "1e300];\n";
+    CHECK(ints.size() > 4 * 1024 * 1024);
+    const ParseOptions parallel_options{.thread_count = 4};
+    const ConfigParser sequential_ints = ConfigParser::FromBuffer(ints, "vectors");
+    const ConfigParser parallel_ints = ConfigParser::FromBuffer(ints, "vectors", parallel_options);
+    CHECK(parallel_ints.ErrorCount() == 0);
+    CHECK(parallel_ints.GetIntVector("ints").size() == kElementCount + 1);
+    CHECK(parallel_ints.GetIntVector("ints") == sequential_ints.GetIntVector("ints"));
+    const ConfigParser sequential_doubles = ConfigParser::FromBuffer(doubles, "vectors");
+    const ConfigParser parallel_doubles =
+            ConfigParser::FromBuffer(doubles, "vectors", parallel_options);
+    CHECK(parallel_doubles.ErrorCount() == 0);
+    CHECK(parallel_doubles.GetDoubleVector("doubles") ==
+          sequential_doubles.GetDoubleVector("doubles"));
+
+    // A bad element near the end, in the last chunk, reports the same error at the same place
+    std::string invalid = ints;
+    invalid.replace(invalid.find(", ", invalid.size() - 100) + 2, 1, "x");
+    const ConfigParser invalid_sequential = ConfigParser::FromBuffer(invalid, "vectors");
+    const ConfigParser invalid_parallel =
+            ConfigParser::FromBuffer(invalid, "vectors", parallel_options);
+    const std::vector<ConfigError> expected = invalid_sequential.Errors();
+    const std::vector<ConfigError> actual = invalid_parallel.Errors();
+    CHECK(expected.size() == 1);
+    CHECK(actual.size() == expected.size());
+    CHECK(!expected.empty() && (expected[0].line > kElementCount / 16 - 10));
+    if (!expected.empty() && (actual.size() == expected.size())) {
+        CHECK(actual[0].code == expected[0].code);
+        CHECK((actual[0].line == expected[0].line) && (actual[0].column == expected[0].column));
+        CHECK(actual[0].offset == expected[0].offset);
+        CHECK(invalid_parallel.ErrorString() == invalid_sequential.ErrorString());
+    }
+}
+
+void TestReparseChanges() {
+    const ConfigParser previous = ConfigParser::FromBuffer(
+            "int kept = 1;\nint changed = 2;\nstring removed = \"x\";\nfloat[] retyped = [1];\n",
+            "reparse");
+    ConfigChanges changes;
+    const ConfigParser reparsed = ConfigParser::Reparse(
+            previous,
+            "int kept = 1;\nint changed = 3;\nint[] retyped = [1];\nbool added = true;\n",
+            &changes);
+    CHECK(reparsed.ErrorCount() == 0);
+    CHECK(changes.added == std::vector<std::string>{"added"});
+    CHECK(changes.removed == std::vector<std::string>{"removed"});
+    CHECK((changes.changed == std::vector<std::string>{"changed", "retyped"}));
+    CHECK(*reparsed.Lookup<int>("changed") == 3);
+    CHECK(*reparsed.Lookup<int>("kept") == 1);
+
+    // Reparsing the same text again reuses every value and changes nothing
+    ConfigChanges no_changes;
+    const ConfigParser again = ConfigParser::Reparse(
+            reparsed,
+            "int kept = 1;\nint changed = 3;\nint[] retyped = [1];\nbool added = true;\n",
+            &no_changes);
+    CHECK(no_changes.Empty());
+    CHECK(again.SchemaId() == reparsed.SchemaId());
+
+    // Invalid text is parsed in full, with its errors and no changes
+    ConfigChanges invalid_changes;
+    const ConfigParser invalid =
+            ConfigParser::Reparse(reparsed, "int kept = one;\n", &invalid_changes);
+    CHECK(invalid.ErrorCount() == 1);
+    CHECK(invalid_changes.Empty());
+}
+
+void TestReparseParsesOnlyChanges() {
+    // A reparsable load records declaration hashes, so that its first reparse reuses values
+    const std::string original = GenerateConfig(1000);
+    const ParseOptions options{.collect_stats = true, .reparsable = true};
+    const ConfigParser loaded = ConfigParser::FromBuffer(original, "reparse", options);
+    // A changed value, an inserted declaration, a moved declaration and a changed comment
+    std::string edited = original;
+    edited.replace(edited.find("int v8 = 8;"), 11, "int v8 = 80;");
+    edited.insert(edited.find("int v16 = 16;"), "int inserted = 1;\n");
+    edited.erase(edited.find("int v24 = 24;\n"), 14);
+    edited += "int v24 = 24;\n";
+    edited.replace(edited.find("# generated"), 11, "# edited");
+    ConfigChanges changes;
+    const ConfigParser reparsed = ConfigParser::Reparse(loaded, edited, &changes);
+    CHECK(reparsed.ErrorCount() == 0);
+    CHECK((reparsed.Stats() != nullptr) && (DeclarationCount(*reparsed.Stats()) == 2));
+    CHECK(changes.changed == std::vector<std::string>{"v8"});
+    CHECK(changes.added == std::vector<std::string>{"inserted"});
+    CHECK(changes.removed.empty());
+    const ConfigParser expected = ConfigParser::FromBuffer(edited, "reparse");
+    CHECK(reparsed.SchemaId() == expected.SchemaId());
+    CHECK(*reparsed.Lookup<int>("v8") == 80);
+    CHECK(reparsed.GetStringVector("v14") == expected.GetStringVector("v14"));
+
+    // Ranges parsed in parallel record the same hashes
+    const std::string large = GenerateConfig(150000);
+    const ConfigParser parallel = ConfigParser::FromBuffer(
+            large, "reparse",
+            ParseOptions{.thread_count = 4, .collect_stats = true, .reparsable = true});
+    const ConfigParser unchanged = ConfigParser::Reparse(parallel, large);
+    CHECK((unchanged.Stats() != nullptr) && (DeclarationCount(*unchanged.Stats()) == 0));
+    CheckSameGeneratedValues(unchanged, parallel, 150000);
+}
+
+void TestLazyValues() {
+    // Lazy values read the same as values parsed at load time
+    const std::string generated = GenerateConfig(1000);
+    const ConfigParser eager = ConfigParser::FromBuffer(generated, "lazy");
+    const ConfigParser lazy = ConfigParser::FromBuffer(generated, "lazy", {.lazy = true});
+    CheckSameGeneratedValues(lazy, eager, 1000);
+    CHECK(lazy.ValidateAll());
+    CHECK(lazy.ErrorCount() == 0);
+
+    // An invalid value is only reported when it is first read, at its own line and column
+    const std::string contents =
+            "int good = 1;\nint bad = 1x;\nstring[] names = [\"a;\",\n    \"b\"];\n"
+            "float worse = q;\n";
+    const ConfigParser invalid = ConfigParser::FromBuffer(contents, "lazy", {.lazy = true});
+    CHECK(invalid.ErrorCount() == 0);
+    CHECK(*invalid.Lookup<int>("good") == 1);
+    CHECK(invalid.ErrorCount() == 0);
+    CHECK(!invalid.Lookup<int>("bad"));
+    CHECK(invalid.Lookup<int>("bad").error() == LookupError::kInvalidValue);
+    std::vector<ConfigError> errors = invalid.Errors();
+    CHECK(errors.size() == 1);
+    CHECK(!errors.empty() && (errors[0].line == 2) && (errors[0].column == 11));
+
+    // ValidateAll reports the rest, each once
+    CHECK(!invalid.ValidateAll());
+    errors = invalid.Errors();
+    CHECK(errors.size() == 2);
+    CHECK((errors.size() == 2) && (errors[1].line == 5) && (errors[1].column == 15));
+    CHECK((invalid.GetStringVector("names") == std::vector<std::string>{"a;", "b"}));
+
+    // Concurrent first reads parse each value once, so the invalid one is reported once
+    const ConfigParser shared = ConfigParser::FromBuffer(contents, "lazy", {.lazy = true});
+    std::vector<std::thread> threads;
+    std::atomic<size_t> good_reads{0};
+    for (size_t i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+            if (*shared.Lookup<int>("good") == 1) ++good_reads;
+            [[maybe_unused]] const bool found = shared.Lookup<int>("bad").has_value();
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    CHECK(good_reads == 8);
+    CHECK(shared.ErrorCount() == 1);
+}
+
+void TestErrorLocations() {
+    // Errors after multi-line vectors and comments holding terminators and quotes
+    const std::string prefix =
+            "# header; with \"terminators\";\nstring[] names = [\"a;\",\n    \"b # c\",\n"
+            "    \"d\"];  # trailing; comment\nint[] primes = [2,\n3, 5];\n";
+    const std::string contents = prefix + "int bad = 1x;\n";
+    for (bool lazy : {false, true}) {
+        const ConfigParser parser =
+                ConfigParser::FromBuffer(contents, "locations", ParseOptions{.lazy = lazy});
+        parser.ValidateAll();
+        const std::vector<ConfigError> errors = parser.Errors();
+        CHECK(errors.size() == 1);
+        CHECK(!errors.empty() && (errors[0].line == 7) && (errors[0].column == 11));
+        CHECK(!errors.empty() && LocatedAtOffset(errors[0], contents));
+    }
+
+    // Errors at every position around the 64-byte blocks that newlines are counted in, including
+    // lines that end on a block boundary
+    size_t mislocated_count = 0;
+    for (size_t padding = 0; padding < 130; ++padding) {
+        const std::string padded = prefix + "# " + std::string(padding, ';') + "\n" +
+                                   std::string(padding % 7, ' ') + "float bad = q;\n";
+        for (bool lazy : {false, true}) {
+            const ConfigParser parser =
+                    ConfigParser::FromBuffer(padded, "locations", ParseOptions{.lazy = lazy});
+            parser.ValidateAll();
+            const std::vector<ConfigError> errors = parser.Errors();
+            if ((errors.size() != 1) || !LocatedAtOffset(errors[0], padded)) ++mislocated_count;
+        }
+        StreamingConfigParser streaming("locations");
+        for (size_t offset = 0; offset < padded.size(); offset += 13) {
+            streaming.Feed(std::string_view(padded).substr(offset, 13));
+        }
+        const std::vector<ConfigError> streamed = streaming.Finish().Errors();
+        if ((streamed.size() != 1) || !LocatedAtOffset(streamed[0], padded)) ++mislocated_count;
+    }
+    CHECK(mislocated_count == 0);
+
+    // An error in a later range of a parallel parse, and ones found lazily far into a large
+    // config, in a value and in a vector element on a later line than its declaration
+    const std::string generated = GenerateConfig(150000) + prefix;
+    const std::string large = generated + "float bad = q;\n";
+    const ConfigParser parallel =
+            ConfigParser::FromBuffer(large, "locations", ParseOptions{.thread_count = 4});
+    const ConfigParser lazy = ConfigParser::FromBuffer(large, "locations", {.lazy = true});
+    CHECK(!lazy.Lookup<float>("bad").has_value());
+    for (const ConfigParser* parser : {&parallel, &lazy}) {
+        const std::vector<ConfigError> errors = parser->Errors();
+        CHECK((errors.size() == 1) && LocatedAtOffset(errors[0], large));
+    }
+    const std::string late = generated + "int[] late = [1, 2,\n x];\n";
+    const ConfigParser lazy_vector = ConfigParser::FromBuffer(late, "locations", {.lazy = true});
+    CHECK(!lazy_vector.Lookup<std::vector<int>>("late").has_value());
+    const std::vector<ConfigError> late_errors = lazy_vector.Errors();
+    CHECK((late_errors.size() == 1) && (late_errors[0].column == 2) &&
+          LocatedAtOffset(late_errors[0], late));
+}
+
+void TestIncludes() {
+    const TempDirectory directory;
+    // Diamond: top includes left and right, which both include bottom
+    directory.Write("bottom.cfg", "int shared = 7;\n");
+    directory.Write("left.cfg", "include \"bottom.cfg\";\nint left = 1;\n");
+    directory.Write("right.cfg", "include \"bottom.cfg\";\nint right = 2;\n");
+    const std::string top = directory.Write(
+            "top.cfg", "include \"left.cfg\";\ninclude \"right.cfg\";\nint top = 3;\n");
+    const ConfigParser diamond(top);
+    CHECK(diamond.ErrorCount() == 0);
+    CHECK(*diamond.Lookup<int>("shared") == 7);
+    CHECK(*diamond.Lookup<int>("left") + *diamond.Lookup<int>("right") == 3);
+
+    // Cycle: first includes second, which includes first
+    directory.Write("second.cfg", "include \"first.cfg\";\nint second = 2;\n");
+    const std::string first =
+            directory.Write("first.cfg", "include \"second.cfg\";\nint first = 1;\n");
+    const ConfigParser cycle(first);
+    const std::vector<ConfigError> errors = cycle.Errors();
+    CHECK(errors.size() == 1);
+    CHECK(!errors.empty() && (errors[0].code == ErrorCode::kIncludeError));
+    CHECK(cycle.ErrorString().find("include cycle") != std::string::npos);
+
+    // A variable declared both in an included config and by the includer
+    const std::string redefined =
+            directory.Write("redefined.cfg", "include \"bottom.cfg\";\nint shared = 1;\n");
+    CHECK(ConfigParser(redefined).Errors().at(0).code == ErrorCode::kRedefinition);
+
+    // Configs parsed from memory resolve relative includes only against an explicit directory
+    const std::string include_bottom = "include \"bottom.cfg\";\nint own = 1;\n";
+    const ConfigParser no_directory = ConfigParser::FromBuffer(include_bottom, "buffer");
+    CHECK((no_directory.ErrorCount() == 1) &&
+          (no_directory.Errors()[0].code == ErrorCode::kRelativeInclude));
+    const ConfigParser with_directory = ConfigParser::FromBuffer(
+            include_bottom, "buffer", ParseOptions{.include_directory = directory.Directory()});
+    CHECK(with_directory.ErrorCount() == 0);
+    CHECK(*with_directory.Lookup<int>("shared") == 7);
+    const ConfigParser absolute = ConfigParser::FromBuffer(
+            "include \"" + directory.Path("bottom.cfg") + "\";\n", "buffer");
+    CHECK((absolute.ErrorCount() == 0) && (*absolute.Lookup<int>("shared") == 7));
+    StreamingConfigParser streaming("stream", directory.Directory());
+    streaming.Feed(include_bottom);
+    const ConfigParser streamed = streaming.Finish();
+    CHECK((streamed.ErrorCount() == 0) && (*streamed.Lookup<int>("shared") == 7));
+    StreamingConfigParser streaming_without_directory("stream");
+    streaming_without_directory.Feed(include_bottom);
+    CHECK(streaming_without_directory.Finish().Errors().at(0).code ==
+          ErrorCode::kRelativeInclude);
+
+    // A loaded file's directory carries over to its reparses and to ranges parsed in parallel
+    const std::string large = directory.Write(
+            "large.cfg", GenerateConfig(150000) + "include \"left.cfg\";\n");
+    const ConfigParser parallel(large, ParseOptions{.thread_count = 4, .collect_stats = true});
+    CHECK((parallel.ErrorCount() == 0) && (*parallel.Lookup<int>("left") == 1));
+    // Merged from the ranges, rather than parsed again after a range failed
+    CHECK((parallel.Stats() != nullptr) && (parallel.Stats()->merge_nanoseconds > 0));
+    const ConfigParser reparsed =
+            ConfigParser::Reparse(ConfigParser(top), "include \"right.cfg\";\nint top = 4;\n");
+    CHECK((reparsed.ErrorCount() == 0) && (*reparsed.Lookup<int>("right") == 2));
+}
+
+void TestConfigSet() {
+    const TempDirectory directory;
+    // Uneven files, the large ones first so that they all start in the first thread's share and
+    // the other threads have to steal the rest of it
+    constexpr size_t kFileCount = 40;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < kFileCount; ++i) {
+        const size_t declaration_count = (i < 4) ? 20000 : 10;
+        paths.push_back(directory.Write("set_" + std::to_string(i) + ".cfg",
+                                        GenerateConfig(declaration_count) + "int file = " +
+                                                std::to_string(i) + ";\n"));
+    }
+    for (size_t thread_count : {1, 4, 64}) {
+        const ConfigSet config_set = ConfigSet::Load(paths, ParseOptions(), thread_count);
+        CHECK(config_set.Size() == kFileCount);
+        CHECK(config_set.ErrorCount() == 0);
+        CHECK(config_set.ErrorString().empty());
+        size_t misplaced_count = 0;
+        for (size_t i = 0; i < config_set.Size(); ++i) {
+            if ((config_set.Path(i) != paths[i]) ||
+                (*config_set.Parser(i).Lookup<int>("file") != static_cast<int>(i))) {
+                ++misplaced_count;
+            }
+        }
+        CHECK(misplaced_count == 0);
+        CHECK((config_set.Size() == kFileCount) &&
+              (config_set.Parser(2).Lookup<int>("v19992").has_value()));
+    }
+    CHECK(ConfigSet::Load({}).Size() == 0);
+
+    // Globs: * and ? in the last component, ordered by path
+    const TempDirectory glob_directory;
+    for (const char* name : {"run_1.cfg", "run_2.cfg", "run_10.cfg", "other.cfg", "run_1.txt"}) {
+        glob_directory.Write(name, "int x = 1;\n");
+    }
+    const ConfigSet star = ConfigSet::LoadGlob(glob_directory.Path("run_*.cfg"));
+    CHECK(star.Size() == 3);
+    CHECK((star.Size() == 3) && (star.Path(0) == glob_directory.Path("run_1.cfg")) &&
+          (star.Path(1) == glob_directory.Path("run_10.cfg")) &&
+          (star.Path(2) == glob_directory.Path("run_2.cfg")));
+    CHECK(star.Find(glob_directory.Path("run_2.cfg")) == &star.Parser(2));
+    CHECK(star.Find(glob_directory.Path("other.cfg")) == nullptr);
+    CHECK(ConfigSet::LoadGlob(glob_directory.Path("run_?.cfg")).Size() == 2);
+    CHECK(ConfigSet::LoadGlob(glob_directory.Path("*")).Size() == 5);
+    CHECK(ConfigSet::LoadGlob(glob_directory.Path("*.json")).Size() == 0);
+    const ConfigSet missing = ConfigSet::LoadGlob(glob_directory.Path("missing/*.cfg"));
+    CHECK((missing.Size() == 0) && (missing.ErrorCount() == 0));
+
+    // Errors are counted over all files and reported per file, in file order
+    const std::string bad_value = glob_directory.Write("bad_value.cfg", "int x = one;\n");
+    const std::string bad_type = glob_directory.Write("bad_type.cfg", "integer x = 1;\n");
+    const std::string absent = glob_directory.Path("absent.cfg");
+    const ConfigSet errors =
+            ConfigSet::Load({paths[0], bad_value, paths[1], bad_type, absent}, ParseOptions(), 3);
+    CHECK(errors.ErrorCount() == 3);
+    const std::vector<std::string> error_strings = errors.ErrorStrings();
+    CHECK(error_strings.size() == 3);
+    CHECK((error_strings.size() == 3) && (error_strings[0] == errors.ErrorString()) &&
+          (error_strings[0].find("bad_value.cfg") != std::string::npos) &&
+          (error_strings[1].find("bad_type.cfg") != std::string::npos) &&
+          (error_strings[2].find("absent.cfg") != std::string::npos));
+    CHECK(errors.Parser(2).ErrorCount() == 0);
+}
+
+void TestLayeredConfig() {
+    LayeredConfig config;
+    config.AddLayer("base", std::make_shared<const ConfigParser>(ConfigParser::FromBuffer(
+                                    "int threads = 1;\nstring mode = \"base\";\n"
+                                    "float rate = 0.5;\nint[] ports = [80];\n",
+                                    "base")));
+    config.AddLayer("prod", std::make_shared<const ConfigParser>(ConfigParser::FromBuffer(
+                                    "int threads = 4;\nstring mode = \"prod\";\n", "prod")));
+    CHECK(config.AddOverrides("command line", {"threads = 8", "ports=[1, 2]"}).empty());
+    CHECK(config.LayerCount() == 3);
+
+    // Each variable comes from the topmost layer declaring it
+    CHECK(*config.Lookup<int>("threads") == 8);
+    CHECK(*config.Lookup<std::string>("mode") == "prod");
+    CHECK(*config.Lookup<float>("rate") == 0.5f);
+    CHECK(std::ranges::equal(*config.Lookup<std::vector<int>>("ports"), std::vector<int>{1, 2}));
+    CHECK(config.SourceLayer("threads") == 2);
+    CHECK(config.SourceLayer("mode") == 1);
+    CHECK(config.SourceLayer("rate") == 0);
+    CHECK(config.SourceLayer("missing") == LayeredConfig::kNoLayer);
+    CHECK(config.LayerName(config.SourceLayer("mode")) == "prod");
+    CHECK(config.Lookup<float>("threads").error() == LookupError::kWrongType);
+    CHECK(config.Variables().Size() == 4);
+
+    // Swapping a layer: variables it no longer declares fall through to the layers below
+    config.SetLayer(1, std::make_shared<const ConfigParser>(
+                               ConfigParser::FromBuffer("float rate = 0.25;\n", "test")));
+    CHECK(*config.Lookup<int>("threads") == 8);
+    CHECK(*config.Lookup<std::string>("mode") == "base");
+    CHECK(*config.Lookup<float>("rate") == 0.25f);
+    CHECK(config.SourceLayer("mode") == 0);
+    CHECK(config.SourceLayer("rate") == 1);
+    CHECK(config.SourceLayer("threads") == 2);
+
+    // Invalid overrides are each reported, and the layer is not added
+    const std::vector<std::string> errors =
+            config.AddOverrides("bad", {"threads", "threads=eight", "rate=[1.5]", "missing=1"});
+    CHECK(errors.size() == 4);
+    CHECK((errors.size() == 4) && (errors[0].find("name=value") != std::string::npos));
+    CHECK((errors.size() == 4) && (errors[3].find("undeclared") != std::string::npos));
+    CHECK(config.LayerCount() == 3);
+    CHECK(*config.Lookup<int>("threads") == 8);
+    CHECK(config.AddOverrides("strings", {"mode=unquoted text"}).empty());
+    CHECK(*config.Lookup<std::string>("mode") == "unquoted text");
+    CHECK(config.SourceLayer("mode") == 3);
+}
+
+void TestAccessProfile() {
+    const std::string contents =
+            "int a = 1;\ndouble[] b = [1, 2];\nstring c = \"c\";\nint unread = 0;\n"
+            "string looked_up = \"x\";\nfloat resolved = 2.5;\n";
+    const ConfigParser unprofiled = ConfigParser::FromBuffer(contents, "profile");
+    CHECK(unprofiled.GetInt("a") == 1);
+    const AccessReport off = unprofiled.ReportAccesses();
+    CHECK(!off.enabled && off.hottest_keys.empty() && off.getters.empty());
+
+    // More threads than shards, each reading keys through getters, Lookup and a handle
+    const ConfigParser profiled =
+            ConfigParser::FromBuffer(contents, "profile", ParseOptions{.profile_access = true});
+    constexpr size_t kThreadCount = 2 * AccessProfile::kShardCount;
+    constexpr uint64_t kReadCount = 1000;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreadCount; ++i) {
+        threads.emplace_back([&] {
+            const ValueHandle<float> resolved = profiled.Resolve<float>("resolved");
+            for (uint64_t read = 0; read < kReadCount; ++read) {
+                [[maybe_unused]] const int a = profiled.GetInt("a");
+                [[maybe_unused]] const std::vector<double> b = profiled.GetDoubleVector("b");
+                [[maybe_unused]] const bool found =
+                        profiled.Lookup<std::string>("looked_up").has_value();
+                [[maybe_unused]] const float value = profiled.Get(resolved);
+            }
+            profiled.GetInt("missing");
+            profiled.GetInt("c");
+            [[maybe_unused]] const bool missing = profiled.Lookup<int>("missing").has_value();
+            [[maybe_unused]] const bool wrong_type = profiled.Lookup<float>("a").has_value();
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    const AccessReport report = profiled.ReportAccesses();
+    CHECK(report.enabled);
+    const auto reads = [&](const std::string& name) {
+        for (const AccessReport::Key& key : report.hottest_keys) {
+            if (key.name == name) return key.reads;
+        }
+        return uint64_t{0};
+    };
+    CHECK(reads("a") == kThreadCount * kReadCount);
+    CHECK(reads("b") == kThreadCount * kReadCount);
+    CHECK(reads("looked_up") == kThreadCount * kReadCount);
+    CHECK(reads("resolved") == kThreadCount * (kReadCount + 1));  // handle reads and Resolve
+    CHECK(reads("c") == 0);
+    CHECK((report.unread_keys == std::vector<std::string>{"c", "unread"}));
+    const auto getter = [&](const std::string& name) {
+        for (const AccessReport::GetterCalls& calls : report.getters) {
+            if (calls.getter == name) return calls;
+        }
+        return AccessReport::GetterCalls{name, 0, 0, 0, 0};
+    };
+    CHECK(getter("GetInt").calls == kThreadCount * (kReadCount + 2));
+    CHECK(getter("GetInt").misses == kThreadCount);
+    CHECK(getter("GetInt").wrong_types == kThreadCount);
+    CHECK(getter("GetDoubleVector").calls == kThreadCount * kReadCount);
+    CHECK(getter("Lookup").calls == kThreadCount * (kReadCount + 2));
+    CHECK(getter("Lookup").misses == kThreadCount);
+    CHECK(getter("Lookup").wrong_types == kThreadCount);
+    CHECK(getter("Resolve").calls == kThreadCount);
+    CHECK(getter("Get").calls == kThreadCount * kReadCount);
+    CHECK(report.getters.size() == 5);
+}
+
+void TestReloadableConfig() {
+    const TempDirectory directory;
+    const std::string path = directory.Write("reloaded.cfg", "int a = 1;\nint b = 2;\n");
+    ReloadableConfig config(path);
+    CHECK(config.Version() == 1);
+    CHECK(config.ErrorCount() == 0);
+    const std::shared_ptr<const ConfigParser> first = config.Snapshot();
+    ReloadableConfig::Reader reader(&config);
+    CHECK(*reader.Get().Lookup<int>("a") == 1);
+
+    // A rewrite is picked up by the watcher and published as a new version
+    directory.Write("reloaded.cfg", "int a = 10;\nint b = 2;\nint c = 3;\n");
+    CHECK(WaitForVersion(config, 2));
+    CHECK(*config.Snapshot()->Lookup<int>("a") == 10);
+    CHECK(*reader.Get().Lookup<int>("c") == 3);
+    CHECK(*first->Lookup<int>("a") == 1);
+    const ConfigChanges changes = config.LastChanges();
+    CHECK(changes.changed == std::vector<std::string>{"a"});
+    CHECK(changes.added == std::vector<std::string>{"c"});
+
+    // A rewrite that fails to parse keeps the previous snapshot and reports its errors
+    directory.Write("reloaded.cfg", "int a = ten;\n");
+    CHECK(!config.Reload());
+    CHECK(config.Version() == 2);
+    CHECK(config.ErrorCount() == 1);
+    CHECK(config.ErrorString().find("line 1, column 9") != std::string::npos);
+    CHECK(*config.Snapshot()->Lookup<int>("a") == 10);
+
+    // Stop joins the watcher; Reload still works and stopping again does nothing
+    config.Stop();
+    directory.Write("reloaded.cfg", "int a = 20;\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(config.Version() == 2);
+    CHECK(config.Reload());
+    CHECK(config.Version() == 3);
+    CHECK(config.ErrorCount() == 0);
+    CHECK(*reader.Get().Lookup<int>("a") == 20);
+    config.Stop();
+}
+
+void TestBinaryCacheRoundTrip() {
+    const TempDirectory directory;
+    const std::string contents = GenerateConfig(200) +
+                                 "int[] no_ints = [];\nstring[] no_strings = [];\n"
+                                 "bool[] no_bools = [];\nstring empty = \"\";\n";
+    const std::string path = directory.Write("cached.cfg", contents);
+    const ParseOptions options{.use_binary_cache = true};
+    const ConfigParser written(path, options);
+    CHECK(written.ErrorCount() == 0);
+    CHECK(std::filesystem::exists(path + ConfigParser::kBinaryCacheSuffix));
+    const ConfigParser read(path, options);
+    CHECK(read.ErrorCount() == 0);
+    CheckSameGeneratedValues(read, ConfigParser::FromBuffer(contents), 200);
+    CHECK(read.GetIntVector("no_ints").empty());
+    CHECK(read.GetStringVector("no_strings").empty());
+    CHECK(read.GetBoolVector("no_bools").empty());
+    CHECK((*read.Lookup<std::string>("empty")).empty());
+
+    // A corrupted cache is ignored
+    std::fstream cache(path + ConfigParser::kBinaryCacheSuffix,
+                       std::ios::in | std::ios::out | std::ios::binary);
+    cache.seekp(-1, std::ios::end);
+    cache.put('\x7f');
+    cache.close();
+    const ConfigParser reparsed(path, options);
+    CHECK(reparsed.ErrorCount() == 0);
+    CheckSameGeneratedValues(reparsed, written, 200);
+}
+
+void TestStatsCounts() {
+    constexpr size_t kCount = 150000;
+    const std::string valid = GenerateConfig(kCount);
+    // A redefinition across ranges makes the parallel parse fall back to parsing sequentially,
+    // which stops at the redefinition, so the same kCount declarations are counted
+    for (bool redefine : {false, true}) {
+        const std::string contents = redefine ? valid + "int v0 = 1;\n" : valid;
+        for (size_t thread_count : {1, 4}) {
+            const ParseOptions options{.thread_count = thread_count, .collect_stats = true};
+            const ConfigParser parser = ConfigParser::FromBuffer(contents, "stats", options);
+            CHECK(parser.ErrorCount() == (redefine ? 1 : 0));
+            const ParseStats* stats = parser.Stats();
+            CHECK(stats != nullptr);
+            if (stats == nullptr) continue;
+            CHECK(DeclarationCount(*stats) == kCount);
+            CHECK(stats->declaration_counts[ValueStore::SlotArrayIndex(VariableType{
+                          ExpressionType::kInt, false})] == kCount / kGeneratedTypeCount);
+            CHECK(stats->bytes == contents.size());
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestNumericParsing();
+    TestStreamingMatchesOneShot();
+    TestParallelMatchesSequential();
+    TestParallelVectorMatchesSequential();
+    TestReparseChanges();
+    TestReparseParsesOnlyChanges();
+    TestLazyValues();
+    TestErrorLocations();
+    TestIncludes();
+    TestConfigSet();
+    TestLayeredConfig();
+    TestAccessProfile();
+    TestReloadableConfig();
+    TestBinaryCacheRoundTrip();
+    TestStatsCounts();
+    if (failure_count != 0) {
+        std::cerr << failure_count << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
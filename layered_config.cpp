@@ -0,0 +1,163 @@
+#include "layered_config.h"
+
+#include <utility>
+
+namespace {
+
+std::string_view TrimWhitespace(std::string_view text) {
+    constexpr std::string_view kWhitespace = " \t\r\n";
+    const size_t begin = text.find_first_not_of(kWhitespace);
+    if (begin == std::string_view::npos) return std::string_view();
+    return text.substr(begin, text.find_last_not_of(kWhitespace) + 1 - begin);
+}
+
+}  // namespace
+
+/** Layers **/
+
+size_t LayeredConfig::AddLayer(const std::string& layer_name,
+                               std::shared_ptr<const ConfigParser> parser) {
+    _layers.push_back(LayerEntry{layer_name, std::move(parser)});
+    IndexLayer(_layers.size() - 1);
+    return _layers.size() - 1;
+}
+
+void LayeredConfig::SetLayer(size_t index, std::shared_ptr<const ConfigParser> parser) {
+    _layers[index].parser = std::move(parser);
+    BuildIndex();
+}
+
+std::vector<std::string> LayeredConfig::AddOverrides(const std::string& layer_name,
+                                                     const std::vector<std::string>& assignments) {
+    std::vector<std::string> errors;
+    std::string declarations;
+    std::vector<std::pair<std::string_view, VariableType>> overridden;
+    for (const std::string& assignment : assignments) {
+        const size_t equals = assignment.find('=');
+        if (equals == std::string::npos) {
+            errors.push_back("Error: override " + assignment + " is not of the form name=value");
+            continue;
+        }
+        const std::string_view assignment_view(assignment);
+        const std::string_view name = TrimWhitespace(assignment_view.substr(0, equals));
+        const std::string_view value = TrimWhitespace(assignment_view.substr(equals + 1));
+        const Variable* variable = FindVariable(name);
+        if (variable == nullptr) {
+            errors.push_back("Error: override of undeclared variable " + std::string(name));
+            continue;
+        }
+        if (value.find_first_of("\r\n") != std::string_view::npos) {
+            errors.push_back("Error: value of override of " + std::string(name) + " spans lines");
+            continue;
+        }
+        const bool quote = (variable->type == VariableType{ExpressionType::kString, false}) &&
+                           !value.starts_with('"');
+        std::string declaration = variable->type.ToString() + " " + std::string(name) + " = ";
+        if (quote) declaration += '"';
+        declaration += value;
+        declaration += quote ? "\";\n" : ";\n";
+        // Parse each assignment on its own first, so that a value cannot declare other variables
+        const ConfigParser parsed = ConfigParser::FromBuffer(declaration, layer_name);
+        if (parsed.ErrorCount() != 0) {
+            errors.push_back(parsed.ErrorString());
+        } else if (parsed._var_map.Size() != 1) {
+            errors.push_back("Error: invalid value for override of " + std::string(name));
+        } else {
+            declarations += declaration;
+            overridden.emplace_back(name, variable->type);
+        }
+    }
+    if (!errors.empty()) return errors;
+
+    // Check the layer as it is actually parsed too, as a value can still change how the
+    // declarations after it read, e.g. by opening a comment or a string that they close
+    ConfigParser parser = ConfigParser::FromBuffer(declarations, layer_name);
+    if (parser.ErrorCount() != 0) {  // e.g. the same variable assigned twice
+        errors.push_back(parser.ErrorString());
+        return errors;
+    }
+    if (parser._var_map.Size() != overridden.size()) {
+        errors.push_back("Error: invalid override values in layer " + layer_name);
+        return errors;
+    }
+    for (const auto& [name, type] : overridden) {
+        const Variable* variable = parser._var_map.Find(name);
+        if ((variable == nullptr) || (variable->type != type)) {
+            errors.push_back("Error: invalid value for override of " + std::string(name));
+        }
+    }
+    if (!errors.empty()) return errors;
+    AddLayer(layer_name, std::make_shared<const ConfigParser>(std::move(parser)));
+    return errors;
+}
+
+void LayeredConfig::BuildIndex() {
+    _stores.clear();
+    _overlay.Clear();
+    for (size_t layer = 0; layer < _layers.size(); ++layer) IndexLayer(layer);
+}
+
+void LayeredConfig::IndexLayer(size_t index) {
+    const ConfigParser& parser = *_layers[index].parser;
+    const size_t store_offset = _stores.size();
+    for (size_t source = 0; source <= parser._included_parsers.size(); ++source) {
+        _stores.push_back(
+                Store{&parser, static_cast<uint16_t>(source), static_cast<uint16_t>(index)});
+    }
+    if (index == 0) return;  // looked up in its own index
+    for (const auto& [name, variable] : parser._var_map) {
+        Variable layered_variable = variable;
+        layered_variable.source = static_cast<uint16_t>(store_offset + variable.source);
+        _overlay.InsertOrAssign(name, layered_variable);
+    }
+}
+
+const Variable* LayeredConfig::FindVariable(std::string_view variable_name) const {
+    if (const Variable* variable = _overlay.Find(variable_name)) return variable;
+    return _layers.empty() ? nullptr : _layers.front().parser->_var_map.Find(variable_name);
+}
+
+VariableIndex LayeredConfig::Variables() const {
+    VariableIndex variables;
+    if (_layers.empty()) return variables;
+    variables = _layers.front().parser->_var_map;
+    for (const auto& [name, variable] : _overlay) variables.InsertOrAssign(name, variable);
+    return variables;
+}
+
+/** Lookups **/
+
+template <typename T>
+LookupResult<T> LayeredConfig::Lookup(std::string_view variable_name) const {
+    const Variable* variable = FindVariable(variable_name);
+    if (variable == nullptr) {
+        return LookupResult<T>(LookupError::kNotFound, variable_name, nullptr);
+    }
+    if (variable->type != ConfigTypeTraits<T>::kVariableType) {
+        return LookupResult<T>(LookupError::kWrongType, variable_name, variable);
+    }
+    const Store& store = _stores[variable->source];
+    if (store.parser->_lazy_values &&
+        !store.parser->ParseLazyValue(Variable{variable->type, store.source, variable->slot})) {
+        return LookupResult<T>(LookupError::kInvalidValue, variable_name, variable);
+    }
+    return LookupResult<T>(store.parser->ViewSlot<T>(store.source, variable->slot));
+}
+
+template LookupResult<std::string> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<int> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<size_t> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<float> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<double> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<bool> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<std::string>> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<int>> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<size_t>> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<float>> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<double>> LayeredConfig::Lookup(std::string_view) const;
+template LookupResult<std::vector<bool>> LayeredConfig::Lookup(std::string_view) const;
+
+size_t LayeredConfig::SourceLayer(std::string_view variable_name) const {
+    const Variable* variable = FindVariable(variable_name);
+    return (variable == nullptr) ? kNoLayer : _stores[variable->source].layer;
+}
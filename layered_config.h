@@ -0,0 +1,96 @@
+/* Layered view over several configs, e.g. a base file, an environment file and command-line
+ * overrides, without merging them into a copy.
+ *
+ * Each layer is a shared ConfigParser; a variable declared in a higher layer overrides the one
+ * with the same name in the layers below it, type included. The indices of the layers above the
+ * bottom one are flattened into a single overlay index when layers change, so a lookup costs at
+ * most two hash lookups (the overlay, then the bottom layer's own index) regardless of the number
+ * of layers, and values are read in place from the layer that declares them, e.g.:
+ *   LayeredConfig config;
+ *   config.AddLayer("base", std::make_shared<const ConfigParser>("base.cfg"));
+ *   config.AddLayer("prod", std::make_shared<const ConfigParser>("prod.cfg"));
+ *   std::vector<std::string> errors = config.AddOverrides("command line", {"threads=8"});
+ *   LookupResult<int> threads = config.Lookup<int>("threads");
+ *   const std::string& from = config.LayerName(config.SourceLayer("threads"));
+ *
+ * The bottom layer's index is used as is, and adding a layer only inserts its own variables into
+ * the overlay, so adding a small layer over a large base costs in proportion to the small layer.
+ * Replacing a layer rebuilds the overlay from every layer above the bottom one, since variables the
+ * old parser declared may have to fall through to the layers below it. Copying a LayeredConfig
+ * shares its layers, e.g. to add per-request overrides to a copy of a common one.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config_parser.h"
+#include "variable_index.h"
+
+class LayeredConfig {
+  public:
+    // Returned by SourceLayer for a variable no layer declares
+    static constexpr size_t kNoLayer = static_cast<size_t>(-1);
+
+    LayeredConfig() = default;
+
+    // Adds a layer above the existing ones and returns its index (0 for the bottom layer)
+    size_t AddLayer(const std::string& layer_name, std::shared_ptr<const ConfigParser> parser);
+    // Replaces the parser of the layer at index, e.g. to switch environments per experiment
+    void SetLayer(size_t index, std::shared_ptr<const ConfigParser> parser);
+    // Adds a layer of "name=value" assignments, e.g. from the command line. Each value is parsed
+    // as the type of the variable it overrides, which must be declared in a layer below; string
+    // values may be given without quotes, and values may not span lines. Returns one error message
+    // per invalid assignment, and only adds the layer if there are none.
+    std::vector<std::string> AddOverrides(const std::string& layer_name,
+                                          const std::vector<std::string>& assignments);
+
+    size_t LayerCount() const { return _layers.size(); }
+    const std::string& LayerName(size_t index) const { return _layers[index].name; }
+    const ConfigParser& Layer(size_t index) const { return *_layers[index].parser; }
+
+    // Looks up a variable in the topmost layer declaring it, as ConfigParser::Lookup does. Lookups
+    // may be called concurrently, but not concurrently with adding or replacing layers.
+    template <typename T>
+    LookupResult<T> Lookup(std::string_view variable_name) const;
+    // Index of the layer the variable's value comes from, or kNoLayer if no layer declares it
+    size_t SourceLayer(std::string_view variable_name) const;
+
+    // Effective variables, in order of first declaration from the bottom layer up, flattened into a
+    // new index. Their sources refer to the layers' stores and are only meaningful to this
+    // LayeredConfig.
+    VariableIndex Variables() const;
+
+  private:
+    struct LayerEntry {
+        std::string name;
+        std::shared_ptr<const ConfigParser> parser;
+    };
+
+    // A ValueStore of a layer: its own (source 0) or one of its included configs'
+    struct Store {
+        const ConfigParser* parser;
+        uint16_t source;  // within parser
+        uint16_t layer;
+    };
+
+    // Rebuilds _stores and _overlay from _layers
+    void BuildIndex();
+    // Adds the stores of the layer at index and its variables to the overlay, above those of the
+    // layers below it; the layers above it must not be indexed yet
+    void IndexLayer(size_t index);
+    // Variable in the topmost layer declaring it, or nullptr
+    const Variable* FindVariable(std::string_view variable_name) const;
+
+    std::vector<LayerEntry> _layers;
+    // Stores of all layers, bottom layer first, indexed by the sources of variables. The bottom
+    // layer's stores come first, so the sources in its own index are valid as they are.
+    std::vector<Store> _stores;
+    // Variables of the layers above the bottom one; others fall through to the bottom layer
+    VariableIndex _overlay;
+};
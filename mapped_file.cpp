@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) : _is_open{false}, _data{nullptr}, _size{0} {
+    std::ifstream input_filestream(path, std::ios::binary);
+    if (!input_filestream.is_open()) return;
+    std::ostringstream ss;
+    ss << input_filestream.rdbuf();
+    _buffer = ss.str();
+    _data = _buffer.data();
+    _size = _buffer.size();
+    _is_open = true;
+}
+
+MappedFile::~MappedFile() {}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) : _is_open{false}, _data{nullptr}, _size{0} {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        return;
+    }
+    _size = static_cast<size_t>(file_stat.st_size);
+    if (_size > 0) {  // mmap does not accept empty mappings
+        void* mapping = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            _size = 0;
+            return;
+        }
+        ::madvise(mapping, _size, MADV_SEQUENTIAL);  // the lexer reads front to back
+        _data = static_cast<const char*>(mapping);
+    }
+    ::close(fd);  // the mapping stays valid after the descriptor is closed
+    _is_open = true;
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) ::munmap(const_cast<char*>(_data), _size);
+}
+
+#endif
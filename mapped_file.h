@@ -0,0 +1,32 @@
+/* Read-only memory mapping of a file.
+ *
+ * On POSIX systems the file is mmap'd, so its contents can be parsed directly out of the page
+ * cache without copying. On other systems the file is read into an owned buffer instead.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOpen() const { return _is_open; }
+    // Contents of the file, valid for the lifetime of the MappedFile
+    std::string_view Contents() const { return std::string_view(_data, _size); }
+
+  private:
+    bool _is_open;
+    const char* _data;
+    size_t _size;
+#if defined(_WIN32)
+    std::string _buffer;  // fallback storage when mmap is unavailable
+#endif
+};
@@ -0,0 +1,122 @@
+#include "numeric_parsing.h"
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+/** Helpers **/
+
+inline bool IsDigit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Removes a leading '+', which std::from_chars does not accept. Returns false if the remaining
+// input starts with another sign.
+bool StripPlusSign(std::string_view* input) {
+    if (!input->empty() && ((*input)[0] == '+')) {
+        input->remove_prefix(1);
+        return input->empty() || (((*input)[0] != '-') && ((*input)[0] != '+'));
+    }
+    return true;
+}
+
+template <typename T>
+bool FromChars(std::string_view input, T* value) {
+    const char* end = input.data() + input.size();
+    const std::from_chars_result result = std::from_chars(input.data(), end, *value);
+    return (result.ec == std::errc()) && (result.ptr == end);
+}
+
+/** Integer kernel **/
+
+// Number of decimal digits that always fit in T without overflow checks
+template <typename T>
+constexpr size_t kFastPathIntegerDigits = std::numeric_limits<T>::digits10;
+
+template <typename T>
+bool ParseInteger(std::string_view input, T* value) {
+    if (!StripPlusSign(&input) || input.empty()) return false;
+    // Fast path: short literals are accumulated directly
+    const bool negative = std::is_signed_v<T> && (input[0] == '-');
+    const std::string_view digits = input.substr(negative ? 1 : 0);
+    if (!digits.empty() && (digits.size() <= kFastPathIntegerDigits<T>)) {
+        T result = 0;
+        for (const char c : digits) {
+            if (!IsDigit(c)) return false;
+            result = static_cast<T>(result * 10 + (c - '0'));
+        }
+        *value = negative ? static_cast<T>(-result) : result;
+        return true;
+    }
+    return FromChars(input, value);
+}
+
+/** Floating point kernel **/
+
+// Plain decimals with at most this many significant digits, and at most kFastPathMaxFraction
+// digits after the point, are computed exactly as integer mantissa / power of ten: both operands
+// are exactly representable, so the IEEE division is correctly rounded.
+template <typename T>
+constexpr size_t kFastPathMaxDigits = std::is_same_v<T, float> ? 7 : 15;
+template <typename T>
+constexpr size_t kFastPathMaxFraction = std::is_same_v<T, float> ? 10 : 22;
+
+template <typename T>
+constexpr T kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                              1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                              1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parses [-]digits[.digits] with few enough digits to be exact, returning false for anything
+// else (which may still be valid, but needs the general parser)
+template <typename T>
+bool ParseShortDecimal(std::string_view input, T* value) {
+    const bool negative = (input[0] == '-');
+    size_t i = negative ? 1 : 0;
+    uint64_t mantissa = 0;
+    size_t digit_count = 0;
+    size_t fraction_digits = 0;
+    for (; (i < input.size()) && IsDigit(input[i]); ++i, ++digit_count) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(input[i] - '0');
+    }
+    if (digit_count == 0) return false;
+    if ((i < input.size()) && (input[i] == '.')) {
+        for (++i; (i < input.size()) && IsDigit(input[i]); ++i, ++fraction_digits) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(input[i] - '0');
+        }
+        digit_count += fraction_digits;
+    }
+    if ((i != input.size()) || (digit_count > kFastPathMaxDigits<T>) ||
+        (fraction_digits > kFastPathMaxFraction<T>)) {
+        return false;
+    }
+    const T result = static_cast<T>(mantissa) / kPowersOfTen<T>[fraction_digits];
+    *value = negative ? -result : result;
+    return true;
+}
+
+template <typename T>
+bool ParseFloatingPoint(std::string_view input, T* value) {
+    if (!StripPlusSign(&input) || input.empty()) return false;
+    return ParseShortDecimal(input, value) || FromChars(input, value);
+}
+
+}  // namespace
+
+bool ParseNumber(std::string_view input, int* value) {
+    return ParseInteger(input, value);
+}
+
+bool ParseNumber(std::string_view input, size_t* value) {
+    return ParseInteger(input, value);
+}
+
+bool ParseNumber(std::string_view input, float* value) {
+    return ParseFloatingPoint(input, value);
+}
+
+bool ParseNumber(std::string_view input, double* value) {
+    return ParseFloatingPoint(input, value);
+}
@@ -0,0 +1,18 @@
+/* Exception-free numeric parsing kernels.
+ *
+ * Each overload parses the entire input as a number of the output type and returns false if it
+ * cannot (including on trailing characters or out-of-range values), without throwing and
+ * independently of the current locale. Integers are optionally signed decimal literals; floating
+ * point values additionally accept fractions, exponents, inf/-inf and nan. Short plain decimal
+ * literals (the common case in configs) take a specialized fast path.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+bool ParseNumber(std::string_view input, int* value);
+bool ParseNumber(std::string_view input, size_t* value);
+bool ParseNumber(std::string_view input, float* value);
+bool ParseNumber(std::string_view input, double* value);
@@ -0,0 +1,81 @@
+#include "parse_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+
+#include "binary_cache.h"
+#include "mapped_file.h"
+
+namespace {
+
+// Current state of the file at path, with a size of -1 if it cannot be read
+IncludedFile StatFile(const std::string& path) {
+    std::error_code error;
+    IncludedFile file{path, std::filesystem::last_write_time(path, error), 0};
+    if (!error) file.size = std::filesystem::file_size(path, error);
+    if (error) file.size = static_cast<uintmax_t>(-1);
+    return file;
+}
+
+bool IsUnchanged(const IncludedFile& file) {
+    const IncludedFile current = StatFile(file.path);
+    return (current.write_time == file.write_time) && (current.size == file.size);
+}
+
+}  // namespace
+
+ParseCache& ParseCache::Global() {
+    static ParseCache parse_cache;
+    return parse_cache;
+}
+
+CachedConfig ParseCache::Get(const std::string& canonical_path,
+                             const std::vector<std::string>& include_chain) {
+    const IncludedFile file = StatFile(canonical_path);
+    std::optional<Entry> cached;
+    {
+        const std::lock_guard<std::mutex> lock(_mutex);
+        const auto entry = _entries.find(canonical_path);
+        if (entry != _entries.end()) cached = entry->second;
+    }
+    const auto includes_unchanged = [](const ConfigParser& parser) {
+        return std::all_of(parser._included_files.begin(), parser._included_files.end(),
+                           IsUnchanged);
+    };
+    if (cached && (cached->config.file.write_time == file.write_time) &&
+        (cached->config.file.size == file.size) && includes_unchanged(*cached->config.parser)) {
+        return cached->config;
+    }
+    const MappedFile mapped_file(canonical_path);
+    if (!mapped_file.IsOpen()) return CachedConfig{nullptr, file};
+    const uint64_t content_hash = HashContents(mapped_file.Contents());
+    CachedConfig config{nullptr, file};
+    if (cached && (cached->content_hash == content_hash) &&
+        includes_unchanged(*cached->config.parser)) {
+        config.parser = cached->config.parser;  // rewritten with the same contents
+    } else {
+        ConfigParser parser;
+        parser._config_path = canonical_path;
+        parser._options.include_directory =
+                std::filesystem::path(canonical_path).parent_path().string();
+        parser._include_chain = include_chain;
+        parser._include_chain.push_back(canonical_path);
+        parser.Parse(mapped_file.Contents(), 1);
+        config.parser = std::make_shared<const ConfigParser>(std::move(parser));
+        if (config.parser->ErrorCount() != 0) return config;
+    }
+    const std::lock_guard<std::mutex> lock(_mutex);
+    _entries.insert_or_assign(canonical_path, Entry{config, content_hash});
+    return config;
+}
+
+size_t ParseCache::Size() const {
+    const std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+void ParseCache::Clear() {
+    const std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+}
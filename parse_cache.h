@@ -0,0 +1,53 @@
+/* Process-wide cache of parsed config files, for include directives.
+ *
+ * A file included by many configs is read and parsed once, and every config including it shares
+ * the resulting ConfigParser (and so its typed values) rather than holding a copy. Entries are
+ * keyed by canonical path. A cached parse is reused while the write time and size of the file,
+ * and of every file it includes, are unchanged; if only the write time changed, the contents are
+ * hashed and compared before parsing again.
+ *
+ * The cache may be used from any number of threads. Parsing happens outside its lock, so two
+ * threads that miss on the same file at once may both parse it.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config_parser.h"
+
+// A parsed config file and the state of the file when it was parsed
+struct CachedConfig {
+    std::shared_ptr<const ConfigParser> parser;  // nullptr if the file could not be read
+    IncludedFile file;
+};
+
+class ParseCache {
+  public:
+    // The cache used by include directives
+    static ParseCache& Global();
+
+    // Returns the parsed config at canonical_path, parsing it unless a parse of its current
+    // contents is cached. include_chain holds the canonical paths of the configs including it,
+    // outermost first. Parses with errors are returned but not cached.
+    CachedConfig Get(const std::string& canonical_path,
+                     const std::vector<std::string>& include_chain);
+
+    size_t Size() const;
+    // Drops all entries; configs already sharing them keep them alive
+    void Clear();
+
+  private:
+    struct Entry {
+        CachedConfig config;
+        uint64_t content_hash;
+    };
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+};
@@ -0,0 +1,157 @@
+#include "parse_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#ifdef CONFIG_PARSER_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+#endif
+
+#include "config_parser.h"
+
+static_assert(ParseStats::kTypeCount == ValueStore::kSlotArrayCount);
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+
+// Orders the heap of slowest declarations with the fastest on top
+bool IsSlower(const ParseStats::Declaration& a, const ParseStats::Declaration& b) {
+    return a.nanoseconds > b.nanoseconds;
+}
+
+// Adds declaration to the heap of slowest declarations if it is among the slowest limit ones
+void AddSlowDeclaration(ParseStats::Declaration&& declaration,
+                        size_t limit,
+                        std::vector<ParseStats::Declaration>* slowest) {
+    if (slowest->size() == limit) {
+        if ((limit == 0) || (declaration.nanoseconds <= slowest->front().nanoseconds)) return;
+        std::pop_heap(slowest->begin(), slowest->end(), IsSlower);
+        slowest->pop_back();
+    }
+    slowest->push_back(std::move(declaration));
+    std::push_heap(slowest->begin(), slowest->end(), IsSlower);
+}
+
+VariableType TypeAt(size_t type_index) {
+    return VariableType{static_cast<ExpressionType>(type_index % ValueStore::kScalarTypeCount),
+                        type_index >= ValueStore::kScalarTypeCount};
+}
+
+}  // namespace
+
+void WriteJsonString(std::ostream& os, std::string_view text) {
+    os << '"';
+    for (const char c : text) {
+        if ((c == '"') || (c == '\\')) os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+#ifdef CONFIG_PARSER_COUNT_ALLOCATIONS
+// Counting replacements of the global allocation functions (the array and nothrow forms call
+// these by default)
+void* operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc((size == 0) ? 1 : size)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// Over-aligned allocations, as made by std::pmr::new_delete_resource()
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const std::size_t aligned_size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+    if (void* pointer = std::aligned_alloc(align, aligned_size)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+#endif
+
+bool CountsAllocations() {
+#ifdef CONFIG_PARSER_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t AllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+std::string ParseStats::ToJson() const {
+    std::ostringstream json;
+    json << "{\"bytes\": " << bytes << ", \"total_nanoseconds\": " << total_nanoseconds
+         << ", \"phase_nanoseconds\": {\"read\": " << read_nanoseconds
+         << ", \"split\": " << split_nanoseconds << ", \"parse\": " << parse_nanoseconds
+         << ", \"merge\": " << merge_nanoseconds << "}, \"types\": [";
+    bool first = true;
+    for (size_t i = 0; i < kTypeCount; ++i) {
+        if (declaration_counts[i] == 0) continue;
+        json << (first ? "" : ", ") << "{\"type\": \"" << TypeAt(i).ToString()
+             << "\", \"declarations\": " << declaration_counts[i]
+             << ", \"value_nanoseconds\": " << value_nanoseconds[i] << "}";
+        first = false;
+    }
+    json << "], \"allocations\": ";
+    if (allocations_counted) {
+        json << allocation_count;
+    } else {
+        json << "null";
+    }
+    json << ", \"slowest_declarations\": [";
+    for (size_t i = 0; i < slowest_declarations.size(); ++i) {
+        const Declaration& declaration = slowest_declarations[i];
+        json << ((i == 0) ? "" : ", ") << "{\"name\": ";
+        WriteJsonString(json, declaration.name);
+        json << ", \"type\": \"" << declaration.type.ToString()
+             << "\", \"nanoseconds\": " << declaration.nanoseconds << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+void ParseStats::AddDeclaration(std::string_view name, VariableType type, uint64_t nanoseconds) {
+    ++declaration_counts[ValueStore::SlotArrayIndex(type)];
+    if ((slowest_declarations.size() == slowest_declaration_limit) &&
+        ((slowest_declaration_limit == 0) ||
+         (nanoseconds <= slowest_declarations.front().nanoseconds))) {
+        return;  // checked before copying the name
+    }
+    AddSlowDeclaration(Declaration{std::string(name), type, nanoseconds},
+                       slowest_declaration_limit, &slowest_declarations);
+}
+
+void ParseStats::Merge(const ParseStats& other) {
+    for (size_t i = 0; i < kTypeCount; ++i) {
+        declaration_counts[i] += other.declaration_counts[i];
+        value_nanoseconds[i] += other.value_nanoseconds[i];
+    }
+    for (const Declaration& declaration : other.slowest_declarations) {
+        AddSlowDeclaration(Declaration(declaration), slowest_declaration_limit,
+                           &slowest_declarations);
+    }
+}
+
+void ParseStats::SortSlowestDeclarations() {
+    std::sort_heap(slowest_declarations.begin(), slowest_declarations.end(), IsSlower);
+}
@@ -0,0 +1,78 @@
+/* Opt-in instrumentation of config loading.
+ *
+ * With ParseOptions::collect_stats, a ConfigParser records the wall time of each phase of its load,
+ * the number of bytes parsed, declaration counts and value parsing time by type, and its slowest
+ * declarations, e.g.:
+ *   ConfigParser config_parser("my_config.cfg", ParseOptions{.collect_stats = true});
+ *   std::cerr << config_parser.Stats()->ToJson() << std::endl;
+ * Without it, no stats are allocated and parsing only tests a null pointer per declaration.
+ *
+ * Heap allocations are only counted in builds defining CONFIG_PARSER_COUNT_ALLOCATIONS (the CMake
+ * option of the same name), which replaces the global operator new with a counting one. The count
+ * covers every thread of the process while the load runs.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "variable_index.h"
+
+struct ParseStats {
+    // Number of variable types, scalar and vector, indexed as by ValueStore::SlotArrayIndex
+    static constexpr size_t kTypeCount = 12;
+
+    struct Declaration {
+        std::string name;
+        VariableType type;
+        uint64_t nanoseconds;  // including its value
+    };
+
+    explicit ParseStats(size_t slowest_declaration_limit = 10)
+        : slowest_declaration_limit{slowest_declaration_limit} {}
+
+    // Wall time of each phase of the load, in nanoseconds. There are no separate comment or
+    // whitespace phases: the lexer skips both while reading declarations.
+    uint64_t read_nanoseconds = 0;   // reading or mapping the file
+    uint64_t split_nanoseconds = 0;  // splitting the input into ranges for parallel parsing
+    uint64_t parse_nanoseconds = 0;  // lexing and parsing declarations, values included
+    uint64_t merge_nanoseconds = 0;  // merging the ranges parsed in parallel
+    uint64_t total_nanoseconds = 0;
+    size_t bytes = 0;  // size of the parsed text
+
+    // Declarations of each type, and the time spent parsing their values (summed over threads;
+    // lazily parsed values are not parsed during the load)
+    std::array<size_t, kTypeCount> declaration_counts{};
+    std::array<uint64_t, kTypeCount> value_nanoseconds{};
+
+    // Heap allocations during the load, if counted (see above)
+    bool allocations_counted = false;
+    uint64_t allocation_count = 0;
+
+    // Slowest declarations, slowest first once the load has finished
+    size_t slowest_declaration_limit;
+    std::vector<Declaration> slowest_declarations;
+
+    // Machine-readable dump, as a single JSON object
+    std::string ToJson() const;
+
+    // Used by ConfigParser while loading
+    void AddDeclaration(std::string_view name, VariableType type, uint64_t nanoseconds);
+    // Adds the counts and times of a range parsed in parallel
+    void Merge(const ParseStats& other);
+    void SortSlowestDeclarations();
+};
+
+// Whether this build counts heap allocations, and the number made so far by the process
+bool CountsAllocations();
+uint64_t AllocationCount();
+
+// Writes text as a JSON string. Variable names cannot contain quotes or whitespace, but may
+// contain backslashes, which are escaped along with quotes.
+void WriteJsonString(std::ostream& os, std::string_view text);
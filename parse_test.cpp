@@ -1,10 +1,21 @@
 #include <iostream>
 
 #include "config_parser.h"
+#include "config_schema.h"
 #include "vector_ostream.hpp"
 
 const std::string kConfigFilename = "test_config.cfg";
 
+struct Dimensions {
+    float height;
+    int length;
+    std::vector<int> primes;
+};
+
+constexpr auto kDimensionsSchema = MakeConfigSchema(ConfigField{"height", &Dimensions::height},
+                                                    ConfigField{"length", &Dimensions::length},
+                                                    ConfigField{"primes", &Dimensions::primes});
+
 int main() {
     std::cout << std::boolalpha;
     // Parse config
@@ -33,6 +44,60 @@ int main() {
     std::cout << "infinities: " << config_parser.GetFloatVector("infinities") << std::endl;
     std::cout << std::endl;
 
+    // Get and print views
+    std::cout << "username (view): " << config_parser.GetStringView("username") << std::endl;
+    std::cout << "primes (span): " << config_parser.GetIntSpan("primes") << std::endl;
+    std::cout << "doubles (span): " << config_parser.GetDoubleSpan("doubles") << std::endl;
+    std::cout << std::endl;
+
+    // Look up values; failed lookups are not added to the parser's errors
+    const LookupResult<float> height = config_parser.Lookup<float>("height");
+    std::cout << "height (lookup): " << height.value_or(0.0f) << std::endl;
+    const LookupResult<int> missing = config_parser.Lookup<int>("missing_variable");
+    std::cout << "missing_variable (lookup): " << missing.ErrorString() << std::endl;
+    std::cout << std::endl;
+
+    // Resolve handles once, then read through them
+    const ValueHandle<float> height_handle = config_parser.Resolve<float>("height");
+    const ValueHandle<std::vector<int>> primes_handle =
+            config_parser.Resolve<std::vector<int>>("primes");
+    std::cout << "height (handle): " << config_parser.Get(height_handle) << std::endl;
+    std::cout << "primes (handle): " << config_parser.Get(primes_handle) << std::endl;
+    std::cout << std::endl;
+
+    // Bind values to struct members
+    Dimensions dimensions{};
+    const std::vector<std::string> bind_errors =
+            BindConfig(config_parser, kDimensionsSchema, &dimensions);
+    for (const std::string& bind_error : bind_errors) std::cout << bind_error << std::endl;
+    std::cout << "dimensions: " << dimensions.height << ", " << dimensions.length << ", "
+              << dimensions.primes << std::endl;
+    std::cout << std::endl;
+
+    // Collect every error of an invalid config in one pass, with the key each error is under
+    const std::string_view invalid_config =
+            "int length = 1609x;\nstring username = Apollys;\nin x = 1;\nbool test_bool = true;\n";
+    const ConfigParser invalid_parser = ConfigParser::FromBuffer(
+            invalid_config, "invalid_config", ParseOptions{.collect_all_errors = true});
+    const std::vector<ConfigError> errors = invalid_parser.Errors();
+    const std::vector<std::string_view> expected_keys = {"length", "username", ""};
+    if (errors.size() != expected_keys.size()) {
+        std::cout << "Expected " << expected_keys.size() << " errors" << std::endl;
+        return -1;
+    }
+    for (size_t i = 0; i < expected_keys.size(); ++i) {
+        const ConfigError& error = errors[i];
+        const std::string_view key = invalid_config.substr(error.key_offset, error.key_size);
+        std::cout << ErrorCodeName(error.code) << " (key \"" << key
+                  << "\"): " << invalid_parser.FormatError(error) << std::endl;
+        if (key != expected_keys[i]) {
+            std::cout << "Expected key \"" << expected_keys[i] << "\"" << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "test_bool (after errors): " << invalid_parser.GetBool("test_bool") << std::endl;
+    std::cout << std::endl;
+
     // Check for errors
     if (config_parser.ErrorCount()) {
         std::cout << config_parser.ErrorString() << std::endl;
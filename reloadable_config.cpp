@@ -0,0 +1,196 @@
+#include "reloadable_config.h"
+
+#include "mapped_file.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Interval between modification time checks when inotify is unavailable
+constexpr std::chrono::milliseconds kPollInterval(1000);
+
+}  // namespace
+
+ReloadableConfig::ReloadableConfig(const std::string& config_path, const ParseOptions& options)
+    : _config_path(config_path),
+      _options(options),
+      _version{0},
+      _error_count{0},
+      _stop_requested{false} {
+    _options.reparsable = !_options.use_binary_cache && !_options.lazy;
+#if defined(__linux__)
+    _stop_event_fd = eventfd(0, EFD_CLOEXEC);
+    StartInotify();
+#endif
+    // Taken before loading, so that the watcher also catches a change made during the load
+    const FileState initial_state = CurrentFileState();
+    Load(true, nullptr);
+    _watcher = std::thread(&ReloadableConfig::Watch, this, initial_state);
+}
+
+void ReloadableConfig::Stop() {
+    {
+        const std::lock_guard<std::mutex> lock(_stop_mutex);
+        if (_stop_requested) return;
+        _stop_requested = true;
+    }
+    _stop_condition.notify_all();
+#if defined(__linux__)
+    if (_stop_event_fd >= 0) {
+        const uint64_t increment = 1;
+        [[maybe_unused]] const ssize_t written =
+                write(_stop_event_fd, &increment, sizeof(increment));
+    }
+#endif
+    _watcher.join();
+#if defined(__linux__)
+    if (_stop_event_fd >= 0) close(_stop_event_fd);
+    if (_inotify_fd >= 0) close(_inotify_fd);
+#endif
+}
+
+bool ReloadableConfig::Reload(ConfigChanges* changes) {
+    return Load(false, changes);
+}
+
+size_t ReloadableConfig::ErrorCount() const {
+    const std::lock_guard<std::mutex> lock(_error_mutex);
+    return _error_count;
+}
+
+std::string ReloadableConfig::ErrorString() const {
+    const std::lock_guard<std::mutex> lock(_error_mutex);
+    return _error_string;
+}
+
+ConfigChanges ReloadableConfig::LastChanges() const {
+    const std::lock_guard<std::mutex> lock(_error_mutex);
+    return _last_changes;
+}
+
+bool ReloadableConfig::Load(bool publish_on_error, ConfigChanges* changes) {
+    const std::lock_guard<std::mutex> reload_lock(_reload_mutex);
+    ConfigChanges found_changes;
+    std::shared_ptr<const ConfigParser> config_parser = Parse(&found_changes);
+    const size_t error_count = config_parser->ErrorCount();
+    const bool publish = (error_count == 0) || publish_on_error;
+    {
+        const std::lock_guard<std::mutex> lock(_error_mutex);
+        _error_count = error_count;
+        _error_string = config_parser->ErrorString();
+        if (publish) _last_changes = found_changes;
+    }
+    if (!publish) return false;
+    _snapshot.store(std::move(config_parser));
+    ++_version;
+    if (changes != nullptr) *changes = std::move(found_changes);
+    return true;
+}
+
+std::shared_ptr<const ConfigParser> ReloadableConfig::Parse(ConfigChanges* changes) const {
+    const std::shared_ptr<const ConfigParser> previous = _snapshot.load();
+    if (previous && !_options.use_binary_cache && !_options.lazy) {
+        const MappedFile mapped_file(_config_path);
+        if (mapped_file.IsOpen()) {
+            // Each reparse takes its options from the previous snapshot, and so from the initial
+            // load, which records declaration hashes
+            return std::make_shared<const ConfigParser>(
+                    ConfigParser::Reparse(*previous, mapped_file.Contents(), changes));
+        }
+    }
+    // A full (and possibly parallel) parse for the initial load; also reports any error opening
+    // the file
+    return std::make_shared<const ConfigParser>(_config_path, _options);
+}
+
+ReloadableConfig::FileState ReloadableConfig::CurrentFileState() const {
+    std::error_code error;
+    const std::filesystem::file_time_type write_time =
+            std::filesystem::last_write_time(_config_path, error);
+    const uintmax_t size = std::filesystem::file_size(_config_path, error);
+    return FileState(write_time, error ? uintmax_t{0} : size);
+}
+
+void ReloadableConfig::Watch(FileState initial_state) {
+    // If inotify fails after a change, the polling watcher sees the file differ from
+    // initial_state and reloads it
+    if (!WatchWithInotify()) WatchByPolling(initial_state);
+}
+
+bool ReloadableConfig::WaitForStop(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(_stop_mutex);
+    return !_stop_condition.wait_for(lock, timeout, [this] { return _stop_requested; });
+}
+
+void ReloadableConfig::WatchByPolling(FileState last_state) {
+    while (WaitForStop(kPollInterval)) {
+        const FileState state = CurrentFileState();
+        if (state == last_state) continue;
+        last_state = state;
+        Load(false, nullptr);
+    }
+}
+
+#if defined(__linux__)
+
+void ReloadableConfig::StartInotify() {
+    _inotify_fd = -1;
+    if (_stop_event_fd < 0) return;
+    const int inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd < 0) return;
+    // Watch the directory rather than the file, since editors often save by renaming a new file
+    // over the old one, which would end a watch on the file itself
+    const std::filesystem::path config_path(_config_path);
+    const std::string directory =
+            config_path.has_parent_path() ? config_path.parent_path().string() : ".";
+    if (inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotify_fd);
+        return;
+    }
+    _inotify_fd = inotify_fd;
+}
+
+bool ReloadableConfig::WatchWithInotify() {
+    if (_inotify_fd < 0) return false;
+    const std::string file_name = std::filesystem::path(_config_path).filename().string();
+    alignas(inotify_event) char buffer[4096];
+    pollfd poll_fds[2] = {{_inotify_fd, POLLIN, 0}, {_stop_event_fd, POLLIN, 0}};
+    while (true) {
+        if (poll(poll_fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;  // interrupted by a signal
+            return false;
+        }
+        if (poll_fds[1].revents != 0) break;  // stop requested
+        if ((poll_fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0) return false;
+        const ssize_t length = read(_inotify_fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if ((errno == EINTR) || (errno == EAGAIN)) continue;
+            return false;
+        }
+        // Reload once per batch of events, however many of them refer to the file. Events lost
+        // to a queue overflow may have been for the file.
+        bool file_changed = false;
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if ((event->mask & IN_Q_OVERFLOW) != 0) file_changed = true;
+            if ((event->len != 0) && (file_name == event->name)) file_changed = true;
+            offset += sizeof(inotify_event) + event->len;
+        }
+        if (file_changed) Load(false, nullptr);
+    }
+    return true;
+}
+
+#else
+
+bool ReloadableConfig::WatchWithInotify() {
+    return false;
+}
+
+#endif
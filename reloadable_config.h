@@ -0,0 +1,143 @@
+/* Config file that is reloaded whenever it changes, for long-running processes.
+ *
+ * Each successfully parsed version of the file is published as an immutable snapshot. Readers
+ * take the current snapshot and keep using it for as long as they hold the shared_ptr, so a reload
+ * never changes values out from under them:
+ *   ReloadableConfig config("my_config.cfg");
+ *   std::shared_ptr<const ConfigParser> snapshot = config.Snapshot();
+ *   float height = snapshot->GetFloat("height");
+ *
+ * Snapshot loads a std::atomic<std::shared_ptr>, which is not lock-free in libstdc++: the load
+ * holds an internal spin lock while it copies the shared_ptr, so concurrent Snapshot calls contend
+ * briefly with each other and with publishing. Hot paths should read through a Reader instead,
+ * one per thread, which keeps its own copy of the snapshot and only loads a new one when the
+ * version counter changes, so that reads between reloads are a single lock-free atomic load:
+ *   thread_local ReloadableConfig::Reader reader(&config);
+ *   float height = reader.Get().GetFloat("height");
+ *
+ * The file is watched from a background thread (with inotify on Linux, and by polling its
+ * modification time elsewhere), and each change is parsed on that thread. A version that fails
+ * to parse is not published; the previous snapshot stays current and the errors are reported by
+ * ErrorCount/ErrorString until the next successful load.
+ *
+ * The initial load is a full load (in parallel with ParseOptions::thread_count), which also records
+ * a hash of each declaration's text (ParseOptions::reparsable). Reloads are then incremental (see
+ * ConfigParser::Reparse): only declarations whose text changed are parsed again, and the variables
+ * added, removed or changed by each reload are reported, so that values derived from the config
+ * can be invalidated selectively. This does not apply with ParseOptions::use_binary_cache or
+ * ParseOptions::lazy, which reload the whole file and do not report changes.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "config_parser.h"
+
+class ReloadableConfig {
+  public:
+    // Loads the file and starts watching it. The first load is always published, even if it has
+    // errors, so that Snapshot never returns nullptr.
+    explicit ReloadableConfig(const std::string& config_path,
+                              const ParseOptions& options = ParseOptions());
+    // Stops watching the file. Snapshots held by readers remain valid.
+    ~ReloadableConfig() { Stop(); }
+
+    ReloadableConfig(const ReloadableConfig&) = delete;
+    ReloadableConfig& operator=(const ReloadableConfig&) = delete;
+
+    // Reads the snapshots of a ReloadableConfig from one thread, copying the current snapshot only
+    // when a new one has been published. Not thread-safe itself; the config must outlive it.
+    class Reader {
+      public:
+        explicit Reader(const ReloadableConfig* config)
+            : _config(config), _version{config->Version()}, _snapshot(config->Snapshot()) {}
+
+        // Current snapshot, valid until the next call to Get
+        const ConfigParser& Get() {
+            const size_t version = _config->Version();
+            if (version != _version) {
+                // Published before the version was incremented, so at least as new as version
+                _snapshot = _config->Snapshot();
+                _version = version;
+            }
+            return *_snapshot;
+        }
+
+      private:
+        const ReloadableConfig* _config;
+        size_t _version;
+        std::shared_ptr<const ConfigParser> _snapshot;
+    };
+
+    // Current snapshot. Never waits for a reload in progress, but is not lock-free (see above).
+    std::shared_ptr<const ConfigParser> Snapshot() const { return _snapshot.load(); }
+    // Number of snapshots published so far, starting at 1 for the initial load
+    size_t Version() const { return _version.load(); }
+
+    // Stops watching the file, waiting for a reload in progress to finish. Reload may still be
+    // called. Called by the destructor; further calls do nothing.
+    void Stop();
+
+    // Parses the file now on the calling thread, publishing it if it has no errors.
+    // Returns whether a new snapshot was published, and if so sets changes (if not null) to the
+    // variables that differ from the previous snapshot.
+    bool Reload(ConfigChanges* changes = nullptr);
+
+    // Errors of the most recent load, or none if it succeeded
+    size_t ErrorCount() const;
+    std::string ErrorString() const;
+    // Variables that differ between the current snapshot and the one before it
+    ConfigChanges LastChanges() const;
+
+  private:
+    // Modification time and size of the file, which change whenever it is rewritten
+    using FileState = std::pair<std::filesystem::file_time_type, uintmax_t>;
+
+    // Parses the file, publishing it if it has no errors or if publish_on_error is set
+    bool Load(bool publish_on_error, ConfigChanges* changes);
+    // Parses the file, incrementally from the current snapshot where possible
+    std::shared_ptr<const ConfigParser> Parse(ConfigChanges* changes) const;
+    FileState CurrentFileState() const;
+    // Background thread body: waits for changes to the file and reloads it. initial_state is the
+    // state of the file before the initial load.
+    void Watch(FileState initial_state);
+    // Starts watching the file's directory for writes and renames, setting _inotify_fd, before
+    // the initial load so that no change after it is missed
+    void StartInotify();
+    // Waits on _inotify_fd for changes; returns false if inotify is unavailable or fails
+    bool WatchWithInotify();
+    // Fallback watcher, comparing the file's state at a fixed interval with last_state
+    void WatchByPolling(FileState last_state);
+    // Waits until the timeout expires or the watcher is stopped; returns false if stopped
+    bool WaitForStop(std::chrono::milliseconds timeout);
+
+    std::string _config_path;
+    ParseOptions _options;
+    std::atomic<std::shared_ptr<const ConfigParser>> _snapshot;
+    std::atomic<size_t> _version;
+    // Reload serializes loads; _error_mutex guards the errors of the last load and the changes
+    // of the last published one
+    std::mutex _reload_mutex;
+    mutable std::mutex _error_mutex;
+    size_t _error_count;
+    std::string _error_string;
+    ConfigChanges _last_changes;
+    // Watcher state
+    std::mutex _stop_mutex;
+    std::condition_variable _stop_condition;
+    bool _stop_requested;
+#if defined(__linux__)
+    int _stop_event_fd;  // eventfd signalled by Stop to wake a watcher blocked in poll
+    int _inotify_fd;     // watching the file's directory, or -1
+#endif
+    std::thread _watcher;
+};
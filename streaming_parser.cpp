@@ -0,0 +1,54 @@
+#include "streaming_parser.h"
+
+#include <algorithm>
+#include <utility>
+
+StreamingConfigParser::StreamingConfigParser(const std::string& source_name,
+                                             const std::string& include_directory)
+    : _scan_offset{0}, _pending_location{0, 1, 1}, _failed{false} {
+    _config_parser._config_path = source_name;
+    _config_parser._options.include_directory = include_directory;
+}
+
+bool StreamingConfigParser::Feed(std::string_view chunk) {
+    if (_failed) return false;
+    _pending.append(chunk);
+    // Find the last terminator, so that all completed declarations are parsed at once
+    size_t end = 0;
+    while (true) {
+        const size_t terminator = _scanner.FindTerminator(_pending, _scan_offset, _scan_offset);
+        if (terminator == DeclarationScanner::kNotFound) break;
+        end = terminator + 1;
+        _scan_offset = end;
+    }
+    _scan_offset = _pending.size();
+    if (end != 0) ParsePending(end);
+    return !_failed;
+}
+
+ConfigParser StreamingConfigParser::Finish() {
+    if (!_failed && !_pending.empty()) ParsePending(_pending.size());
+    _pending.clear();
+    return std::move(_config_parser);
+}
+
+void StreamingConfigParser::ParsePending(size_t end) {
+    const std::string_view parsed(_pending.data(), end);
+    if (!_config_parser.ParseRange(parsed, 0, end, _pending_location)) {
+        // Stop at the first error, as for a whole buffer
+        _failed = true;
+        _pending = std::string();
+        return;
+    }
+    // Advance the location past the parsed declarations
+    const size_t newline_count = std::count(parsed.begin(), parsed.end(), '\n');
+    if (newline_count == 0) {
+        _pending_location.column += end;
+    } else {
+        _pending_location.line += newline_count;
+        _pending_location.column = end - parsed.rfind('\n');
+    }
+    _pending_location.offset += end;
+    _pending.erase(0, end);
+    _scan_offset -= end;
+}
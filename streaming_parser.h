@@ -0,0 +1,56 @@
+/* Incremental parsing of a config that arrives in pieces, e.g. from a socket or pipe.
+ *
+ * Chunks may split the input anywhere, including inside a string, a comment or a vector
+ * expression. Each declaration is parsed and stored as soon as its terminating ';' has arrived,
+ * and only the unfinished declaration is buffered, so memory use is bounded by the largest single
+ * declaration (plus the chunk being fed) rather than by the whole input, e.g.:
+ *   StreamingConfigParser streaming_parser("socket");
+ *   while (ReadChunk(socket, &chunk)) streaming_parser.Feed(chunk);
+ *   ConfigParser config_parser = streaming_parser.Finish();
+ * The result, including any error message and its line and column, is the same as parsing the
+ * concatenated chunks in one piece.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "config_lexer.h"
+#include "config_parser.h"
+#include "structural_scanner.h"
+
+class StreamingConfigParser {
+  public:
+    // source_name is used in place of the file path in error messages. Relative includes resolve
+    // against include_directory, and are errors without one (see ParseOptions::include_directory).
+    explicit StreamingConfigParser(
+            const std::string& source_name = ConfigParser::kBufferSourceName,
+            const std::string& include_directory = std::string());
+
+    // Parses every declaration completed by chunk. Returns false once a parsing error has occurred,
+    // after which further input is ignored.
+    bool Feed(std::string_view chunk);
+    bool Feed(const char* data, size_t size) { return Feed(std::string_view(data, size)); }
+
+    // Parses the remaining input (the last declaration's ';' is optional, as for a whole buffer)
+    // and returns the result. The StreamingConfigParser must not be used afterwards.
+    ConfigParser Finish();
+
+    // Declarations parsed so far
+    const ConfigParser& Parser() const { return _config_parser; }
+
+  private:
+    // Parses _pending up to end, which is just after a terminator or the end of the input
+    void ParsePending(size_t end);
+
+    ConfigParser _config_parser;
+    // Input received since the end of the last parsed declaration
+    std::string _pending;
+    // Position in _pending up to which _scanner has searched for terminators
+    size_t _scan_offset;
+    DeclarationScanner _scanner;
+    // Location of the start of _pending in the whole input
+    SourceLocation _pending_location;
+    bool _failed;
+};
@@ -0,0 +1,216 @@
+#include "structural_scanner.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CONFIG_PARSER_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+#if defined(CONFIG_PARSER_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define CONFIG_PARSER_HAVE_AVX2 1
+#endif
+
+namespace {
+
+using ClassifyFunction = StructuralMasks (*)(const char* data);
+
+/** Scalar implementation **/
+
+enum CharClassBits : uint8_t {
+    kSpaceBit = 1,
+    kDelimiterBit = 2,
+    kNewlineBit = 4,
+    kQuoteBit = 8,
+    kCommentBit = 16,
+};
+
+constexpr std::array<uint8_t, 256> MakeCharClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) table[c] |= kSpaceBit;
+    for (unsigned char c : {'"', '#', '=', '[', ']', ',', ';'}) table[c] |= kDelimiterBit;
+    table['\n'] |= kNewlineBit;
+    table['"'] |= kQuoteBit;
+    table['#'] |= kCommentBit;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> kCharClassTable = MakeCharClassTable();
+
+[[maybe_unused]] StructuralMasks ClassifyScalar(const char* data) {
+    StructuralMasks masks{0, 0, 0, 0, 0};
+    for (size_t i = 0; i < kStructuralBlockSize; ++i) {
+        const uint8_t char_class = kCharClassTable[static_cast<unsigned char>(data[i])];
+        masks.space |= static_cast<uint64_t>((char_class & kSpaceBit) != 0) << i;
+        masks.delimiter |= static_cast<uint64_t>((char_class & kDelimiterBit) != 0) << i;
+        masks.newline |= static_cast<uint64_t>((char_class & kNewlineBit) != 0) << i;
+        masks.quote |= static_cast<uint64_t>((char_class & kQuoteBit) != 0) << i;
+        masks.comment |= static_cast<uint64_t>((char_class & kCommentBit) != 0) << i;
+    }
+    return masks;
+}
+
+/** SSE2 implementation **/
+
+#if defined(CONFIG_PARSER_HAVE_SSE2)
+
+inline __m128i EqualsSse2(__m128i v, char c) {
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+inline uint64_t MovemaskSse2(__m128i v) {
+    return static_cast<uint16_t>(_mm_movemask_epi8(v));
+}
+
+StructuralMasks ClassifySse2(const char* data) {
+    StructuralMasks masks{0, 0, 0, 0, 0};
+    for (size_t i = 0; i < kStructuralBlockSize; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // \t, \n, \v, \f, \r are the contiguous range 9-13: (v - 9) <= 4 as unsigned bytes
+        const __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(9));
+        const __m128i control_space =
+                _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+        const __m128i space = _mm_or_si128(control_space, EqualsSse2(v, ' '));
+        const __m128i quote = EqualsSse2(v, '"');
+        const __m128i brackets = _mm_or_si128(EqualsSse2(v, '['), EqualsSse2(v, ']'));
+        const __m128i separators = _mm_or_si128(EqualsSse2(v, ','), EqualsSse2(v, ';'));
+        const __m128i comment = EqualsSse2(v, '#');
+        const __m128i others = _mm_or_si128(comment, EqualsSse2(v, '='));
+        const __m128i delimiter =
+                _mm_or_si128(_mm_or_si128(quote, others), _mm_or_si128(brackets, separators));
+        masks.space |= MovemaskSse2(space) << i;
+        masks.delimiter |= MovemaskSse2(delimiter) << i;
+        masks.newline |= MovemaskSse2(EqualsSse2(v, '\n')) << i;
+        masks.quote |= MovemaskSse2(quote) << i;
+        masks.comment |= MovemaskSse2(comment) << i;
+    }
+    return masks;
+}
+
+#endif
+
+/** AVX2 implementation **/
+
+#if defined(CONFIG_PARSER_HAVE_AVX2)
+
+__attribute__((target("avx2"))) inline __m256i EqualsAvx2(__m256i v, char c) {
+    return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+__attribute__((target("avx2"))) inline uint64_t MovemaskAvx2(__m256i v) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+}
+
+__attribute__((target("avx2"))) StructuralMasks ClassifyAvx2(const char* data) {
+    StructuralMasks masks{0, 0, 0, 0, 0};
+    for (size_t i = 0; i < kStructuralBlockSize; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        // \t, \n, \v, \f, \r are the contiguous range 9-13: (v - 9) <= 4 as unsigned bytes
+        const __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+        const __m256i control_space =
+                _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+        const __m256i space = _mm256_or_si256(control_space, EqualsAvx2(v, ' '));
+        const __m256i quote = EqualsAvx2(v, '"');
+        const __m256i brackets = _mm256_or_si256(EqualsAvx2(v, '['), EqualsAvx2(v, ']'));
+        const __m256i separators = _mm256_or_si256(EqualsAvx2(v, ','), EqualsAvx2(v, ';'));
+        const __m256i comment = EqualsAvx2(v, '#');
+        const __m256i others = _mm256_or_si256(comment, EqualsAvx2(v, '='));
+        const __m256i delimiter = _mm256_or_si256(_mm256_or_si256(quote, others),
+                                                  _mm256_or_si256(brackets, separators));
+        masks.space |= MovemaskAvx2(space) << i;
+        masks.delimiter |= MovemaskAvx2(delimiter) << i;
+        masks.newline |= MovemaskAvx2(EqualsAvx2(v, '\n')) << i;
+        masks.quote |= MovemaskAvx2(quote) << i;
+        masks.comment |= MovemaskAvx2(comment) << i;
+    }
+    return masks;
+}
+
+#endif
+
+/** Runtime dispatch **/
+
+struct Implementation {
+    ClassifyFunction classify;
+    const char* name;
+};
+
+Implementation SelectImplementation() {
+#if defined(CONFIG_PARSER_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2")) return Implementation{ClassifyAvx2, "avx2"};
+#endif
+#if defined(CONFIG_PARSER_HAVE_SSE2)
+    return Implementation{ClassifySse2, "sse2"};
+#else
+    return Implementation{ClassifyScalar, "scalar"};
+#endif
+}
+
+const Implementation& GetImplementation() {
+    static const Implementation implementation = SelectImplementation();
+    return implementation;
+}
+
+}  // namespace
+
+StructuralMasks ClassifyBlock(const char* data, size_t available_size) {
+    if (available_size >= kStructuralBlockSize) {
+        return GetImplementation().classify(data);
+    }
+    // Pad the final partial block with whitespace
+    char padded_block[kStructuralBlockSize];
+    std::memset(padded_block, ' ', kStructuralBlockSize);
+    std::memcpy(padded_block, data, available_size);
+    return GetImplementation().classify(padded_block);
+}
+
+const char* StructuralScannerImplementation() {
+    return GetImplementation().name;
+}
+
+size_t DeclarationScanner::FindTerminator(std::string_view input,
+                                          size_t begin,
+                                          size_t min_position) {
+    for (size_t block_start = begin; block_start < input.size();
+         block_start += kStructuralBlockSize) {
+        const size_t block_size = std::min(input.size() - block_start, kStructuralBlockSize);
+        const size_t block_end = block_start + block_size;
+        const StructuralMasks masks = ClassifyBlock(input.data() + block_start, block_size);
+        // Skip blocks that can neither change the mode nor contain a terminator
+        if ((_mode == Mode::kNormal) && ((masks.quote | masks.comment) == 0) &&
+            (block_end <= min_position)) {
+            continue;
+        }
+        if ((_mode == Mode::kString) && (masks.quote == 0)) continue;
+        if ((_mode == Mode::kComment) && (masks.newline == 0)) continue;
+        // Positions that can change the mode, plus candidate terminators from min_position on
+        const uint64_t in_block =
+                (block_size == 64) ? ~uint64_t{0} : ((uint64_t{1} << block_size) - 1);
+        uint64_t events = (masks.quote | masks.comment | masks.newline) & in_block;
+        if (block_end > min_position) {
+            const size_t first_candidate =
+                    (min_position > block_start) ? (min_position - block_start) : 0;
+            events |= masks.delimiter & in_block & (~uint64_t{0} << first_candidate);
+        }
+        while (events != 0) {
+            const size_t position = block_start + std::countr_zero(events);
+            events &= events - 1;
+            const char ch = input[position];
+            if (_mode == Mode::kString) {
+                if (ch == '"') _mode = Mode::kNormal;
+            } else if (_mode == Mode::kComment) {
+                if (ch == '\n') _mode = Mode::kNormal;
+            } else if (ch == '"') {
+                _mode = Mode::kString;
+            } else if (ch == '#') {
+                _mode = Mode::kComment;
+            } else if ((ch == ';') && (position >= min_position)) {
+                return position;
+            }
+        }
+    }
+    return kNotFound;
+}
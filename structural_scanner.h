@@ -0,0 +1,55 @@
+/* Vectorized classification of structural characters for the lexer.
+ *
+ * The input is processed in 64-byte blocks. Each block is classified into bitmasks (bit i set
+ * iff byte i of the block is in the given class), so the lexer can find token boundaries, skip
+ * whitespace runs and comments, and count newlines with bit operations instead of testing one
+ * byte at a time. Classification uses AVX2 or SSE2 when available (selected at runtime), with a
+ * scalar fallback.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+struct StructuralMasks {
+    uint64_t space;      // whitespace, including newlines
+    uint64_t delimiter;  // characters that end a word: " # = [ ] , ;
+    uint64_t newline;    // \n
+    uint64_t quote;      // "
+    uint64_t comment;    // #
+};
+
+constexpr size_t kStructuralBlockSize = 64;
+
+// Classifies the block of up to kStructuralBlockSize bytes starting at data. If fewer than
+// kStructuralBlockSize bytes are available, the missing bytes are classified as whitespace.
+StructuralMasks ClassifyBlock(const char* data, size_t available_size);
+
+// Name of the implementation selected at runtime ("avx2", "sse2" or "scalar")
+const char* StructuralScannerImplementation();
+
+// Finds the semicolons that end declarations, skipping those inside strings and comments.
+// Whether the scan is inside a string or comment carries over from one call to the next, so an
+// input can be scanned in consecutive pieces (e.g. as it arrives from a stream).
+class DeclarationScanner {
+  public:
+    static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+    DeclarationScanner() : _mode{Mode::kNormal} {}
+
+    // Scans input from begin, returning the position of the first declaration-terminating ';' at
+    // or after min_position, or kNotFound if there is none before the end of input. The next call
+    // must continue from just after the returned position, or from the end of input if none.
+    size_t FindTerminator(std::string_view input, size_t begin, size_t min_position);
+
+  private:
+    enum class Mode {
+        kNormal,
+        kString,
+        kComment,
+    };
+
+    Mode _mode;
+};
@@ -0,0 +1,72 @@
+#include "variable_index.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "config_parser.h"
+
+std::string VariableType::ToString() const {
+    return ConfigParser::kValidTypeStrings[static_cast<size_t>(type)] + (is_vector ? "[]" : "");
+}
+
+const Variable* VariableIndex::Find(std::string_view name) const {
+    if (_entries.empty()) return nullptr;
+    const uint32_t bucket = _buckets[FindBucket(name, HashName(name))];
+    return (bucket == kEmptyBucket) ? nullptr : &_entries[bucket - 1].variable;
+}
+
+bool VariableIndex::Insert(std::string_view name, const Variable& variable) {
+    // Keep the table at most half full, so that probe sequences stay short
+    if (2 * (_entries.size() + 1) > _buckets.size()) {
+        Rehash(std::max(kMinBucketCount, 2 * _buckets.size()));
+    }
+    const uint32_t hash = HashName(name);
+    const size_t bucket = FindBucket(name, hash);
+    if (_buckets[bucket] != kEmptyBucket) return false;
+    _entries.push_back(Entry{hash, static_cast<uint32_t>(_names.size()),
+                             static_cast<uint32_t>(name.size()), variable});
+    _names.append(name);
+    _buckets[bucket] = static_cast<uint32_t>(_entries.size());
+    return true;
+}
+
+void VariableIndex::InsertOrAssign(std::string_view name, const Variable& variable) {
+    if (Insert(name, variable)) return;
+    _entries[_buckets[FindBucket(name, HashName(name))] - 1].variable = variable;
+}
+
+void VariableIndex::Reserve(size_t count) {
+    _entries.reserve(count);
+    const size_t bucket_count = std::bit_ceil(std::max(kMinBucketCount, 2 * count));
+    if (bucket_count > _buckets.size()) Rehash(bucket_count);
+}
+
+void VariableIndex::Clear() {
+    _names.clear();
+    _entries.clear();
+    _buckets.assign(_buckets.size(), kEmptyBucket);
+}
+
+uint32_t VariableIndex::HashName(std::string_view name) {
+    const uint64_t hash = std::hash<std::string_view>{}(name);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+size_t VariableIndex::FindBucket(std::string_view name, uint32_t hash) const {
+    for (size_t bucket = hash & _mask;; bucket = (bucket + 1) & _mask) {
+        const uint32_t entry_index = _buckets[bucket];
+        if (entry_index == kEmptyBucket) return bucket;
+        const Entry& entry = _entries[entry_index - 1];
+        if ((entry.hash == hash) && (Name(entry) == name)) return bucket;
+    }
+}
+
+void VariableIndex::Rehash(size_t bucket_count) {
+    _buckets.assign(bucket_count, kEmptyBucket);
+    _mask = bucket_count - 1;
+    for (size_t i = 0; i < _entries.size(); ++i) {
+        size_t bucket = _entries[i].hash & _mask;
+        while (_buckets[bucket] != kEmptyBucket) bucket = (bucket + 1) & _mask;
+        _buckets[bucket] = static_cast<uint32_t>(i + 1);
+    }
+}
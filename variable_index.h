@@ -0,0 +1,126 @@
+/* Variables, and the flat hash index from their names to them.
+ *
+ * Names are interned into a single character buffer, and variables are stored densely in
+ * insertion (declaration) order. Lookups go through an open-addressing table of entry indices
+ * with linear probing, which compares a stored 32-bit hash before touching the name itself, so
+ * a lookup typically costs one hash of the name and two cache misses.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class ExpressionType : uint8_t {
+    kString,
+    kInt,
+    kUint,
+    kFloat,
+    kDouble,
+    kBool,
+};
+
+// Type of a variable: the type of its value(s), and whether it holds a vector
+struct VariableType {
+    ExpressionType type;
+    bool is_vector;
+
+    bool operator==(const VariableType&) const = default;
+    // Type name as written in configs, e.g. "float[]"
+    std::string ToString() const;
+};
+
+// Attributes of a variable except for its name
+struct Variable {
+    VariableType type;
+    // Which ValueStore holds the value: 0 for the config's own, or 1 + the index of the included
+    // config it comes from
+    uint16_t source;
+    uint32_t slot;  // index of the parsed value within the ValueStore array for its type
+};
+
+class VariableIndex {
+  private:
+    struct Entry {
+        uint32_t hash;
+        uint32_t name_offset;  // position of the name within _names
+        uint32_t name_size;
+        Variable variable;
+    };
+
+  public:
+    // Iterates over (name, variable) pairs in insertion order
+    class Iterator {
+      public:
+        Iterator(const VariableIndex* index, size_t position)
+            : _index(index), _position(position) {}
+
+        std::pair<std::string_view, const Variable&> operator*() const {
+            const Entry& entry = _index->_entries[_position];
+            return {_index->Name(entry), entry.variable};
+        }
+        Iterator& operator++() {
+            ++_position;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const = default;
+
+      private:
+        const VariableIndex* _index;
+        size_t _position;
+    };
+
+    // Allocates its buffers from resource
+    explicit VariableIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : _names(resource), _entries(resource), _buckets(resource), _mask{0} {}
+
+    // Returns the variable with the given name, or nullptr if there is none
+    const Variable* Find(std::string_view name) const;
+    // Position in insertion order of a variable returned by Find
+    size_t Position(const Variable* variable) const {
+        return static_cast<size_t>(reinterpret_cast<const Entry*>(
+                                           reinterpret_cast<const char*>(variable) -
+                                           offsetof(Entry, variable)) -
+                                   _entries.data());
+    }
+    // Adds a variable, returning false (and leaving the index unchanged) if the name is taken
+    bool Insert(std::string_view name, const Variable& variable);
+    // Adds a variable, or replaces the variable with the same name (keeping its position)
+    void InsertOrAssign(std::string_view name, const Variable& variable);
+
+    void Reserve(size_t count);
+    void Clear();
+    size_t Size() const { return _entries.size(); }
+
+    // Name and variable at a position in insertion order
+    std::pair<std::string_view, const Variable&> At(size_t position) const {
+        return *Iterator(this, position);
+    }
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, _entries.size()); }
+
+  private:
+    static constexpr uint32_t kEmptyBucket = 0;  // buckets hold entry index + 1
+    static constexpr size_t kMinBucketCount = 16;
+
+    static uint32_t HashName(std::string_view name);
+
+    std::string_view Name(const Entry& entry) const {
+        return std::string_view(_names.data() + entry.name_offset, entry.name_size);
+    }
+    // Returns the bucket holding name, or the empty bucket where it would be inserted
+    size_t FindBucket(std::string_view name, uint32_t hash) const;
+    // Rebuilds the bucket table with at least bucket_count buckets
+    void Rehash(size_t bucket_count);
+
+    std::pmr::string _names;
+    std::pmr::vector<Entry> _entries;
+    std::pmr::vector<uint32_t> _buckets;
+    size_t _mask;  // bucket count - 1, for a power-of-two bucket count
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ostream>
+#include <span>
 #include <vector>
 #include <string>
 
@@ -25,3 +26,15 @@ inline std::ostream& operator<<(std::ostream& os, const std::vector<std::string>
     os << "]";
     return os;
 }
+
+// Span overload, printing in the same format as std::vector
+template <typename T>
+std::ostream& operator<<(std::ostream& os, std::span<T> s) {
+    os << "[";
+    for (size_t i = 0; i < s.size(); ++i) {
+        os << s[i];
+        if (i + 1 < s.size()) os << ", ";
+    }
+    os << "]";
+    return os;
+}